@@ -0,0 +1,321 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscBootPerf.c
+ * @brief Boot performance regression gate
+ *
+ * Captures a few boot milestones of the running image: the uptime when we started, the uptime of
+ * the xconf response, the uptime when all critical processes were up and MemAvailable once the
+ * image is validated. The milestones of the last validated image are kept in /nvram as the
+ * baseline, and a new image is compared against it when its verdict is reached. A milestone which
+ * is worse than the baseline by more than the threshold is a regression, which is logged with a
+ * telemetry marker and can optionally fail the image.
+ *
+ * Like the boot record, nothing is written once the running image has become the baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "fscMonitor.h"
+
+#define FSC_BOOT_PERF_FILE "/nvram/fscBootPerf"
+#define FSC_BOOT_PERF_TMP_FILE "/nvram/fscBootPerf.tmp"
+#define FSC_BOOT_PERF_MAGIC 0x46534250 /* "FSBP" */
+#define FSC_BOOT_PERF_VERSION 1
+
+// Default regression threshold in percent, and the slack below which a difference is noise
+#define FSC_BOOT_PERF_THRESHOLD 20
+#define FSC_BOOT_PERF_SLACK_MS 5000
+#define FSC_BOOT_PERF_SLACK_KB 4096
+
+// Telemetry profiles pick regressions up from the log by this marker
+#define FSC_BOOT_PERF_MARKER "FSC_BOOT_PERF_REGRESSION"
+
+typedef struct {
+    uint32_t image;             // crc of the imagename
+    uint32_t startMs;           // uptime when fscMonitor started
+    uint32_t xconfMs;           // uptime of the xconf response, 0 if never seen
+    uint32_t processesMs;       // uptime when all critical processes were up, 0 if never seen
+    uint32_t memAvailableKb;    // MemAvailable at the verdict
+} fscBootPerfRecord_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    fscBootPerfRecord_t baseline;   // last validated image
+    fscBootPerfRecord_t last;       // last measured image which was not the baseline
+    uint32_t crc;                   // crc of all fields above
+} fscBootPerfFile_t;
+
+static fscBootPerfFile_t perfFile;
+static fscBootPerfRecord_t current;
+static int threshold = FSC_BOOT_PERF_THRESHOLD;
+
+static uint32_t bootPerfCrc(const fscBootPerfFile_t *file)
+{
+    return (uint32_t)crc32(0L, (const Bytef *)file, offsetof(fscBootPerfFile_t, crc));
+}
+
+/*
+ * Uptime in milliseconds, suspend included like /proc/uptime
+ */
+static uint32_t uptimeMs(void)
+{
+    return (uint32_t)(fscClockUptime() * 1000.0);
+}
+
+/*
+ * Start time of a process in milliseconds since boot, 0 if it could not be read
+ */
+uint32_t fscBootPerfProcessStartMs(pid_t pid)
+{
+    char path[32];
+    char buf[512];
+    unsigned long long startTicks;
+    char *p;
+    ssize_t len;
+    int fd, field;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = 0;
+
+    // The comm field may contain spaces, the fields we want follow its closing paren. Each space
+    // from there on starts the next field, the state right after the paren is field 3 and
+    // starttime is field 22.
+    if ((p = strrchr(buf, ')')) == NULL)
+        return 0;
+    for (field = 2; field < 22 && p != NULL; field++)
+        p = strchr(p + 1, ' ');
+    if (p == NULL || sscanf(p + 1, "%llu", &startTicks) != 1)
+        return 0;
+
+    return (uint32_t)(startTicks * 1000 / sysconf(_SC_CLK_TCK));
+}
+
+static uint32_t readMemAvailableKb(void)
+{
+    char line[128];
+    unsigned long kb = 0;
+    FILE *fp;
+
+    if ((fp = fopen("/proc/meminfo", "r")) == NULL)
+        return 0;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "MemAvailable: %lu kB", &kb) == 1)
+            break;
+    }
+    fclose(fp);
+
+    return (uint32_t)kb;
+}
+
+/*
+ * Replace the file in one go, the old file stays intact until the rename
+ */
+static BOOLEAN bootPerfStore(void)
+{
+    char path[FSC_ROOT_PATH_LEN], tmpPath[FSC_ROOT_PATH_LEN];
+    const char *file = fscRootPath(FSC_BOOT_PERF_FILE, path, sizeof(path));
+    const char *tmpFile = fscRootPath(FSC_BOOT_PERF_TMP_FILE, tmpPath, sizeof(tmpPath));
+    int fd;
+
+    perfFile.crc = bootPerfCrc(&perfFile);
+
+    if ((fd = open(tmpFile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening %s \n", tmpFile);
+        return FALSE;
+    }
+
+    if (write(fd, &perfFile, sizeof(perfFile)) != (ssize_t)sizeof(perfFile) || fdatasync(fd) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error writing %s \n", tmpFile);
+        close(fd);
+        unlink(tmpFile);
+        return FALSE;
+    }
+    close(fd);
+
+    if (rename(tmpFile, file) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error renaming %s \n", tmpFile);
+        unlink(tmpFile);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Compare a milestone against the baseline, higher is worse unless bLowerIsWorse is set
+ */
+static BOOLEAN checkMilestone(const char *name, uint32_t value, uint32_t base, uint32_t slack,
+                              BOOLEAN bLowerIsWorse, char *reason, size_t len)
+{
+    uint32_t worse;
+
+    if (value == 0 || base == 0)
+        return FALSE;
+
+    worse = bLowerIsWorse ? (base > value ? base - value : 0) : (value > base ? value - base : 0);
+    if (worse <= slack || (uint64_t)worse * 100 <= (uint64_t)base * threshold)
+        return FALSE;
+
+    FSC_LOG(LOG_SEV_WARN, "%s: %s %u against baseline %u (%d%% threshold)\n", FSC_BOOT_PERF_MARKER, name, value, base, threshold);
+    if (reason[0] == 0)
+        snprintf(reason, len, "boot performance regression in %s (%u vs %u)", name, value, base);
+
+    return TRUE;
+}
+
+/*
+ * Regression threshold in percent
+ */
+int fscBootPerfSetThreshold(const char *percent)
+{
+    char *end;
+    long value = strtol(percent, &end, 10);
+
+    if (*end != 0 || value <= 0 || value > 1000) {
+        fprintf(stderr, "Invalid boot performance threshold %s\n", percent);
+        return -1;
+    }
+
+    threshold = (int)value;
+    return 0;
+}
+
+/*
+ * Note our start and load the baseline
+ */
+void fscBootPerfInit(void)
+{
+    char imageName[256] = {0};
+    char path[FSC_ROOT_PATH_LEN];
+    int fd;
+
+    current.startMs = uptimeMs();
+    if (fscGetImageName(imageName, sizeof(imageName)))
+        current.image = (uint32_t)crc32(0L, (const Bytef *)imageName, strlen(imageName));
+
+    memset(&perfFile, 0, sizeof(perfFile));
+    if ((fd = open(fscRootPath(FSC_BOOT_PERF_FILE, path, sizeof(path)), O_RDONLY)) >= 0) {
+        if (read(fd, &perfFile, sizeof(perfFile)) != (ssize_t)sizeof(perfFile) ||
+            perfFile.magic != FSC_BOOT_PERF_MAGIC || perfFile.version != FSC_BOOT_PERF_VERSION ||
+            perfFile.crc != bootPerfCrc(&perfFile)) {
+            FSC_LOG(LOG_SEV_WARN, "Boot performance record is invalid, ignoring\n");
+            memset(&perfFile, 0, sizeof(perfFile));
+        }
+        close(fd);
+    }
+
+    perfFile.magic = FSC_BOOT_PERF_MAGIC;
+    perfFile.version = FSC_BOOT_PERF_VERSION;
+}
+
+/*
+ * The xconf response arrived, its time is taken from the response file itself rather than from
+ * the sample which noticed it
+ */
+void fscBootPerfMarkXconf(const char *responseFile)
+{
+    struct stat st;
+    uint32_t now = uptimeMs();
+    time_t age;
+
+    if (current.xconfMs != 0)
+        return;
+
+    current.xconfMs = now;
+    if (stat(responseFile, &st) == 0 && (age = fscClockWallTime() - st.st_mtime) >= 0 && (uint32_t)age * 1000 < now)
+        current.xconfMs = now - (uint32_t)age * 1000;
+}
+
+/*
+ * All critical processes are up, the milestone is the start of the last one of them
+ */
+void fscBootPerfMarkProcesses(void)
+{
+    uint32_t start, latest = 0;
+    int i;
+
+    if (current.processesMs != 0)
+        return;
+
+    for (i = 0; i < fscProcCount(); i++) {
+        if ((start = fscBootPerfProcessStartMs(fscProcPid(i))) == 0) {
+            latest = uptimeMs();
+            break;
+        }
+        if (start > latest)
+            latest = start;
+    }
+
+    current.processesMs = latest != 0 ? latest : uptimeMs();
+}
+
+/*
+ * The verdict has been reached, compare against the baseline and store the milestones. Returns
+ * TRUE if the image regressed, bFail tells whether the image is failed for that.
+ */
+BOOLEAN fscBootPerfVerdict(BOOLEAN bValid, BOOLEAN bFail, char *reason, size_t len)
+{
+    const fscBootPerfRecord_t *base = &perfFile.baseline;
+    BOOLEAN bRegressed = FALSE;
+
+    reason[0] = 0;
+    if (bValid)
+        current.memAvailableKb = readMemAvailableKb();
+
+    FSC_LOG(LOG_SEV_INFO, "Boot milestones: start %u ms, xconf %u ms, processes %u ms, MemAvailable %u kB\n",
+            current.startMs, current.xconfMs, current.processesMs, current.memAvailableKb);
+
+    // Only a new image is measured against the baseline, and only it is recorded
+    if (current.image == 0 || current.image == base->image)
+        return FALSE;
+
+    if (base->image != 0) {
+        bRegressed |= checkMilestone("start", current.startMs, base->startMs, FSC_BOOT_PERF_SLACK_MS, FALSE, reason, len);
+        bRegressed |= checkMilestone("xconf", current.xconfMs, base->xconfMs, FSC_BOOT_PERF_SLACK_MS, FALSE, reason, len);
+        bRegressed |= checkMilestone("processes", current.processesMs, base->processesMs, FSC_BOOT_PERF_SLACK_MS, FALSE, reason, len);
+        bRegressed |= checkMilestone("MemAvailable", current.memAvailableKb, base->memAvailableKb, FSC_BOOT_PERF_SLACK_KB, TRUE, reason, len);
+    }
+
+    perfFile.last = current;
+    // A regressed image which is failed for it must not become the baseline
+    if (bValid && !(bRegressed && bFail)) {
+        perfFile.baseline = current;
+        FSC_LOG(LOG_SEV_INFO, "Boot milestones stored as the new baseline\n");
+    }
+    bootPerfStore();
+
+    return bRegressed;
+}
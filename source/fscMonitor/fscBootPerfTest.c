@@ -0,0 +1,131 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscBootPerfTest.c
+ * @brief Process start time tests
+ *
+ * Reads the start time of this process and of init through fscBootPerfProcessStartMs() and
+ * checks them against starttime as the kernel documents it: field 22 of /proc/<pid>/stat.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fscMonitor.h"
+
+// Only the process start times are tested, nothing else of the daemon is needed
+double fscClockUptime(void)
+{
+    return 0.0;
+}
+
+time_t fscClockWallTime(void)
+{
+    return 0;
+}
+
+BOOLEAN fscGetImageName(char *name, size_t len)
+{
+    (void)name;
+    (void)len;
+    return FALSE;
+}
+
+int fscProcCount(void)
+{
+    return 0;
+}
+
+pid_t fscProcPid(int idx)
+{
+    (void)idx;
+    return 0;
+}
+
+const char *fscRootPath(const char *path, char *buf, size_t len)
+{
+    (void)buf;
+    (void)len;
+    return path;
+}
+
+/*
+ * starttime of the process in ms, read with sscanf rather than by counting spaces
+ */
+static BOOLEAN expectedStartMs(const char *file, uint32_t *ms)
+{
+    unsigned long long startTicks;
+    char buf[512];
+    const char *p;
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL)
+        return FALSE;
+    if (fgets(buf, sizeof(buf), fp) == NULL) {
+        fclose(fp);
+        return FALSE;
+    }
+    fclose(fp);
+
+    if ((p = strrchr(buf, ')')) == NULL ||
+        sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &startTicks) != 1)
+        return FALSE;
+
+    *ms = (uint32_t)(startTicks * 1000 / sysconf(_SC_CLK_TCK));
+    return TRUE;
+}
+
+static BOOLEAN check(const char *name, pid_t pid, const char *file)
+{
+    uint32_t expected, start;
+
+    if (!expectedStartMs(file, &expected)) {
+        printf("FAIL: %s: unable to read %s\n", name, file);
+        return FALSE;
+    }
+
+    start = fscBootPerfProcessStartMs(pid);
+    if (start != expected) {
+        printf("FAIL: %s: start %u ms, expected %u ms\n", name, start, expected);
+        return FALSE;
+    }
+
+    printf("PASS: %s: started %u ms after boot\n", name, start);
+    return TRUE;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    if (!check("self", getpid(), "/proc/self/stat"))
+        failed++;
+    if (!check("init", 1, "/proc/1/stat"))
+        failed++;
+
+    // init came first, and a process which just started cannot read back 0
+    if (fscBootPerfProcessStartMs(getpid()) == 0 || fscBootPerfProcessStartMs(getpid()) < fscBootPerfProcessStartMs(1)) {
+        printf("FAIL: start times out of order\n");
+        failed++;
+    }
+
+    return failed ? 1 : 0;
+}
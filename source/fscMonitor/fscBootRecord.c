@@ -0,0 +1,232 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscBootRecord.c
+ * @brief Boot attempt ring
+ *
+ * Keeps a small record of the last boot attempts of unvalidated images in /nvram so that a boot
+ * looping image can be failed right at startup. The record is double buffered: two copies live in
+ * the same file, each protected by a CRC and a sequence number, and every update overwrites the
+ * older copy. A power cut in the middle of an update therefore always leaves one good copy behind.
+ *
+ * The attempts count the boots of one image which never got as far as a verdict. They start over
+ * when a different image boots and once a verdict is delivered, so failed boots of an earlier
+ * image are never held against a new one. Only the count is used: boot times are wall clock times,
+ * which are meaningless on a box that keeps rebooting before it can sync its clock.
+ *
+ * An image without a name cannot be told from any other, so its boots are not recorded at all.
+ *
+ * To keep NAND wear down the record is written at most once per boot and once per verdict, and not
+ * at all once the running image has been validated.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "fscMonitor.h"
+
+#define FSC_BOOT_RECORD_FILE "/nvram/fscBootRecord"
+#define FSC_BOOT_RECORD_MAGIC 0x46534342 /* "FSCB" */
+#define FSC_BOOT_RECORD_VERSION 1
+#define FSC_BOOT_RING_SIZE 8
+
+// Image is boot looping after this many boots without a verdict
+#define FSC_BOOT_LOOP_LIMIT 5
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;          // copy with the highest sequence wins
+    uint32_t validatedImage;    // crc of the last validated imagename
+    uint32_t attempts;          // boots of the image in the ring without a verdict
+    uint32_t head;              // next ring slot to use
+    struct {
+        uint32_t bootTime;      // wall clock time of the boot
+        uint32_t image;         // crc of the imagename
+    } ring[FSC_BOOT_RING_SIZE];
+    uint32_t crc;               // crc of all fields above
+} fscBootRecord_t;
+
+static fscBootRecord_t bootRecord;
+static int activeCopy = -1;
+static uint32_t currentImage = 0;
+
+static uint32_t bootRecordCrc(const fscBootRecord_t *rec)
+{
+    return (uint32_t)crc32(0L, (const Bytef *)rec, offsetof(fscBootRecord_t, crc));
+}
+
+/*
+ * Load the newest intact copy, returns the copy index or -1 if neither copy is usable
+ */
+static int bootRecordLoad(int fd, fscBootRecord_t *rec)
+{
+    fscBootRecord_t copy;
+    int best = -1;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (pread(fd, &copy, sizeof(copy), (off_t)(i * sizeof(copy))) != (ssize_t)sizeof(copy))
+            continue;
+
+        if (copy.magic != FSC_BOOT_RECORD_MAGIC || copy.version != FSC_BOOT_RECORD_VERSION ||
+            copy.crc != bootRecordCrc(&copy)) {
+            FSC_LOG(LOG_SEV_WARN, "Boot record copy %d is invalid, ignoring\n", i);
+            continue;
+        }
+
+        if (best < 0 || (int32_t)(copy.sequence - rec->sequence) > 0) {
+            *rec = copy;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/*
+ * Write the record over the older copy and flush it to flash
+ */
+static BOOLEAN bootRecordStore(void)
+{
+    int target = (activeCopy == 0) ? 1 : 0;
+    char path[FSC_ROOT_PATH_LEN];
+    const char *file = fscRootPath(FSC_BOOT_RECORD_FILE, path, sizeof(path));
+    int fd;
+
+    if ((fd = open(file, O_WRONLY | O_CREAT, 0644)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening %s \n", file);
+        return FALSE;
+    }
+
+    bootRecord.sequence++;
+    bootRecord.crc = bootRecordCrc(&bootRecord);
+
+    if (pwrite(fd, &bootRecord, sizeof(bootRecord), (off_t)(target * sizeof(bootRecord))) != (ssize_t)sizeof(bootRecord) ||
+        fdatasync(fd) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error writing %s \n", file);
+        close(fd);
+        return FALSE;
+    }
+    close(fd);
+
+    activeCopy = target;
+    return TRUE;
+}
+
+static void bootRecordReset(void)
+{
+    bootRecord.attempts = 0;
+    memset(bootRecord.ring, 0, sizeof(bootRecord.ring));
+    bootRecord.head = 0;
+}
+
+/*
+ * Load the record and account for this boot
+ */
+void fscBootRecordInit(void)
+{
+    char imageName[256] = {0};
+    char path[FSC_ROOT_PATH_LEN];
+    uint32_t last;
+    int fd;
+
+    if (fscGetImageName(imageName, sizeof(imageName)))
+        currentImage = (uint32_t)crc32(0L, (const Bytef *)imageName, strlen(imageName));
+
+    // The record stays unloaded, so neither the loop check nor the verdict touch it
+    if (currentImage == 0) {
+        FSC_LOG(LOG_SEV_WARN, "Image name unknown, boot not recorded\n");
+        return;
+    }
+
+    memset(&bootRecord, 0, sizeof(bootRecord));
+    if ((fd = open(fscRootPath(FSC_BOOT_RECORD_FILE, path, sizeof(path)), O_RDONLY)) >= 0) {
+        activeCopy = bootRecordLoad(fd, &bootRecord);
+        close(fd);
+    }
+
+    if (activeCopy < 0) {
+        memset(&bootRecord, 0, sizeof(bootRecord));
+        bootRecord.magic = FSC_BOOT_RECORD_MAGIC;
+        bootRecord.version = FSC_BOOT_RECORD_VERSION;
+    }
+
+    // Nothing to track for an image which has already been validated
+    if (bootRecord.validatedImage == currentImage) {
+        FSC_LOG(LOG_SEV_INFO, "Image %s already validated, boot not recorded\n", imageName);
+        return;
+    }
+
+    // The ring only ever holds boots of one image, a different one starts over
+    last = (bootRecord.head + FSC_BOOT_RING_SIZE - 1) % FSC_BOOT_RING_SIZE;
+    if (bootRecord.attempts != 0 && bootRecord.ring[last].image != currentImage) {
+        FSC_LOG(LOG_SEV_INFO, "New image, forgetting %u boot attempts of the previous one\n", bootRecord.attempts);
+        bootRecordReset();
+    }
+
+    bootRecord.attempts++;
+    bootRecord.ring[bootRecord.head].bootTime = (uint32_t)fscClockWallTime();
+    bootRecord.ring[bootRecord.head].image = currentImage;
+    bootRecord.head = (bootRecord.head + 1) % FSC_BOOT_RING_SIZE;
+
+    bootRecordStore();
+
+    FSC_LOG(LOG_SEV_INFO, "Unvalidated boot attempt %u of image %s\n", bootRecord.attempts, imageName);
+}
+
+/*
+ * Check to see if the current image is boot looping
+ */
+BOOLEAN fscBootRecordIsLooping(char *reason, size_t len)
+{
+    if (currentImage == 0 || bootRecord.validatedImage == currentImage)
+        return FALSE;
+
+    if (bootRecord.attempts >= FSC_BOOT_LOOP_LIMIT) {
+        snprintf(reason, len, "boot loop detected (%u boots without a verdict)", bootRecord.attempts);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * A verdict ends the attempts. A validated image is remembered so later boots of it do not touch
+ * flash, an invalid one is rolled back and must not count against the next image.
+ */
+void fscBootRecordVerdict(BOOLEAN bValidImage)
+{
+    if (currentImage == 0 || bootRecord.magic != FSC_BOOT_RECORD_MAGIC || bootRecord.validatedImage == currentImage)
+        return;
+
+    if (bValidImage)
+        bootRecord.validatedImage = currentImage;
+    else if (bootRecord.attempts == 0)
+        return;
+    bootRecordReset();
+
+    if (bootRecordStore())
+        FSC_LOG(LOG_SEV_INFO, "Image %s, boot record cleared\n", bValidImage ? "validated" : "invalid");
+}
@@ -0,0 +1,166 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscClock.c
+ * @brief Time source
+ *
+ * All time the checker acts upon is read through here, and the event loop asks the clock how long
+ * it may block. The real clock reads the kernel clocks. The virtual clock runs along with the real
+ * one, but when the loop has nothing to do it jumps straight to the next timer or sample instead of
+ * waiting for it, so a whole validation hour runs in as long as its samples take. Sleeps move it
+ * forward the same way. Time really spent working still counts, a sample stalled on flash takes
+ * as long on the virtual clock as on the real one.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+#include "fscMonitor.h"
+
+typedef struct {
+    const char *name;
+    double (*read)(clockid_t id);       // seconds on one of the kernel clocks
+    int (*blockMs)(int timeoutMs);      // how long the event loop may block for a timeout
+    void (*idle)(int timeoutMs);        // the event loop timed out without any events
+    void (*sleep)(double seconds);
+} fscClockOps_t;
+
+static double realRead(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static int realBlockMs(int timeoutMs)
+{
+    return timeoutMs;
+}
+
+static void realIdle(int timeoutMs)
+{
+    (void)timeoutMs;
+}
+
+static void realSleep(double seconds)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1000000000.0);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+static const fscClockOps_t realClock = {
+    "real", realRead, realBlockMs, realIdle, realSleep
+};
+
+// Waits and sleeps skipped since the virtual clock took over
+static double virtualSkipped = 0;
+
+static double virtualRead(clockid_t id)
+{
+    return realRead(id) + virtualSkipped;
+}
+
+static int virtualBlockMs(int timeoutMs)
+{
+    // File descriptors are still served, just never waited for
+    (void)timeoutMs;
+    return 0;
+}
+
+static void virtualIdle(int timeoutMs)
+{
+    if (timeoutMs > 0)
+        virtualSkipped += (double)timeoutMs / 1000.0;
+}
+
+static void virtualSleep(double seconds)
+{
+    if (seconds > 0)
+        virtualSkipped += seconds;
+}
+
+static const fscClockOps_t virtualClock = {
+    "virtual", virtualRead, virtualBlockMs, virtualIdle, virtualSleep
+};
+
+static const fscClockOps_t *clockOps = &realClock;
+
+/*
+ * Switch to the virtual clock, must be called before anything reads the time
+ */
+void fscClockSetVirtual(void)
+{
+    virtualSkipped = 0;
+    clockOps = &virtualClock;
+
+    FSC_LOG(LOG_SEV_INFO, "Using the %s clock\n", clockOps->name);
+}
+
+BOOLEAN fscClockIsVirtual(void)
+{
+    return clockOps == &virtualClock;
+}
+
+/*
+ * Current monotonic time in seconds
+ */
+double fscMonotonicTime(void)
+{
+    return clockOps->read(CLOCK_MONOTONIC);
+}
+
+/*
+ * Time since boot in seconds, suspend included like /proc/uptime
+ */
+double fscClockUptime(void)
+{
+    return clockOps->read(CLOCK_BOOTTIME);
+}
+
+/*
+ * Wall clock time
+ */
+time_t fscClockWallTime(void)
+{
+    return (time_t)clockOps->read(CLOCK_REALTIME);
+}
+
+void fscClockSleep(double seconds)
+{
+    clockOps->sleep(seconds);
+}
+
+/*
+ * Used by the event loop, see fscClockOps_t
+ */
+int fscClockBlockMs(int timeoutMs)
+{
+    return clockOps->blockMs(timeoutMs);
+}
+
+void fscClockIdle(int timeoutMs)
+{
+    clockOps->idle(timeoutMs);
+}
@@ -0,0 +1,178 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscCtl.c
+ * @brief Control socket server
+ *
+ * Serves the fscCtl.h protocol from the main event loop. All sockets are non-blocking; a client
+ * which does not pick up its response in time simply loses it.
+ *
+ * The control commands can validate an image, e.g. by clearing the debug override, so the socket
+ * is only accessible to its owner and peers running as anyone but root or ourselves are refused.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fscMonitor.h"
+#include "fscCtl.h"
+
+#define FSC_CTL_BACKLOG 8
+
+static int listenFd = -1;
+
+static void ctlCloseClient(int fd)
+{
+    fscLoopRemove(fd);
+    close(fd);
+}
+
+static void ctlHandleClient(int fd, uint32_t events, void *ctx)
+{
+    fscCtlRequest_t req;
+    fscCtlResponse_t rsp;
+    ssize_t len;
+
+    (void)ctx;
+
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        ctlCloseClient(fd);
+        return;
+    }
+
+    len = recv(fd, &req, sizeof(req), MSG_DONTWAIT);
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+        ctlCloseClient(fd);
+        return;
+    }
+    if (len < 0)
+        return;
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.magic = FSC_CTL_MAGIC;
+    rsp.command = req.command;
+    rsp.result = 0;
+
+    if (len != (ssize_t)sizeof(req) || req.magic != FSC_CTL_MAGIC) {
+        rsp.result = -1;
+    } else {
+        switch (req.command) {
+        case FSC_CTL_STATUS:
+            break;
+        case FSC_CTL_RECHECK:
+            FSC_LOG(LOG_SEV_INFO, "Recheck requested over the control socket\n");
+            fscRequestRecheck();
+            break;
+        case FSC_CTL_DEBUG_OVERRIDE:
+            FSC_LOG(LOG_SEV_INFO, "Debug override %s over the control socket\n", req.arg ? "enabled" : "disabled");
+            fscSetDebugOverride(req.arg ? TRUE : FALSE);
+            break;
+        default:
+            rsp.result = -1;
+            break;
+        }
+    }
+
+    rsp.status = *fscStatusCurrent();
+
+    if (send(fd, &rsp, sizeof(rsp), MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)sizeof(rsp))
+        ctlCloseClient(fd);
+}
+
+static BOOLEAN ctlPeerAllowed(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error reading control peer credentials: %s\n", strerror(errno));
+        return FALSE;
+    }
+
+    if (cred.uid != 0 && cred.uid != geteuid()) {
+        FSC_LOG(LOG_SEV_WARN, "Control connection from pid %d uid %u refused\n", (int)cred.pid, (unsigned int)cred.uid);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void ctlHandleListen(int fd, uint32_t events, void *ctx)
+{
+    int clientFd;
+
+    (void)events;
+    (void)ctx;
+
+    while ((clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (!ctlPeerAllowed(clientFd) || fscLoopAdd(clientFd, EPOLLIN, ctlHandleClient, NULL) != 0)
+            close(clientFd);
+    }
+}
+
+/*
+ * Create the control socket and register it with the event loop
+ */
+void fscCtlInit(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    struct sockaddr_un addr;
+
+    if ((listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating control socket: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fscRootPath(FSC_CTL_SOCKET, path, sizeof(path)));
+    unlink(addr.sun_path);
+
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(addr.sun_path, 0600) != 0 ||
+        listen(listenFd, FSC_CTL_BACKLOG) != 0 ||
+        fscLoopAdd(listenFd, EPOLLIN, ctlHandleListen, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting up control socket %s: %s\n", addr.sun_path, strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+/*
+ * Remove the control socket
+ */
+void fscCtlShutdown(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+
+    if (listenFd < 0)
+        return;
+
+    fscLoopRemove(listenFd);
+    close(listenFd);
+    unlink(fscRootPath(FSC_CTL_SOCKET, path, sizeof(path)));
+    listenFd = -1;
+}
@@ -0,0 +1,56 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscCtl.h
+ * @brief Firmware Sanity Checker control protocol
+ *
+ * fscMonitor serves a SOCK_SEQPACKET unix socket while it is running. Every request and every
+ * response is a single fixed size message, so a query is one send and one receive on each side.
+ */
+
+#ifndef FSC_CTL_H
+#define FSC_CTL_H
+
+#include <stdint.h>
+
+#include "fscStatus.h"
+
+#define FSC_CTL_SOCKET "/tmp/fscMonitor.ctl"
+#define FSC_CTL_MAGIC 0x4643 /* "FC" */
+
+typedef enum {
+    FSC_CTL_STATUS = 1,         // return the current status
+    FSC_CTL_RECHECK,            // take a sample right away
+    FSC_CTL_DEBUG_OVERRIDE      // arg 1 forces the check on, 0 turns the override off
+} eFscCtlCommand;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t command;           // eFscCtlCommand
+    uint32_t arg;
+} fscCtlRequest_t;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t command;           // command being answered
+    int32_t result;             // 0 on success, -1 for an unknown or malformed request
+    fscStatus_t status;         // status after the command was applied
+} fscCtlResponse_t;
+
+#endif /* FSC_CTL_H */
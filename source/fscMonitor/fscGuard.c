@@ -0,0 +1,233 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscGuard.c
+ * @brief Deadline-guarantee mode
+ *
+ * A bad image under memory pressure is exactly when fscMonitor must not be paged out or OOM killed.
+ * With --guard the process makes itself hard to kill with oom_score_adj and locks its memory. The
+ * lock uses MCL_ONFAULT, so a thread stack is not pinned to its full reserved size. Once the modules
+ * are set up, the stacks, buffers and code are faulted in, so the verdict path never waits on a
+ * page fault. With --sched fifo|rr the process also runs in a real time class at the lowest
+ * priority. That is still above every normal task, and fscMonitor sleeps nearly all the time.
+ * fscMonitor runs no commands, so nothing has to be kept out of that class. Threads inherit it,
+ * fscGuardThreadInit() sets it again for threads started before the guard and faults in the
+ * stack of each thread we start.
+ *
+ * The resident and locked memory is logged after pre-faulting and at exit, to budget the mode by.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "fscMonitor.h"
+
+#ifndef MCL_ONFAULT
+#define MCL_ONFAULT 4
+#endif
+
+// Leaves -1000, never kill, to the processes which truly cannot go
+#define FSC_GUARD_OOM_SCORE_ADJ -900
+
+// Depth of stack faulted in for each thread, far more than any of our call chains use
+#define FSC_GUARD_STACK_PREFAULT (64 * 1024)
+
+// Anonymous mappings larger than this are the untouched depth of thread stacks or malloc arenas
+#define FSC_GUARD_MAX_ANON_PREFAULT (1024 * 1024)
+
+static BOOLEAN bGuard = FALSE;
+static int schedPolicy = SCHED_OTHER;
+
+void fscGuardEnable(void)
+{
+    bGuard = TRUE;
+}
+
+/*
+ * Real time class for the process, implies the guard mode
+ */
+int fscGuardSetScheduler(const char *policy)
+{
+    if (strcmp(policy, "fifo") == 0) {
+        schedPolicy = SCHED_FIFO;
+    } else if (strcmp(policy, "rr") == 0) {
+        schedPolicy = SCHED_RR;
+    } else {
+        fprintf(stderr, "Unknown scheduling class %s, must be fifo or rr\n", policy);
+        return -1;
+    }
+
+    bGuard = TRUE;
+    return 0;
+}
+
+BOOLEAN fscGuardEnabled(void)
+{
+    return bGuard;
+}
+
+/*
+ * Fault in the stack below the caller, mlockall keeps the pages resident from then on
+ */
+static void prefaultStack(void)
+{
+    volatile char stack[FSC_GUARD_STACK_PREFAULT];
+    size_t i;
+
+    for (i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+static void setScheduler(void)
+{
+    struct sched_param param;
+
+    if (schedPolicy == SCHED_OTHER)
+        return;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_min(schedPolicy);
+    if (sched_setscheduler(0, schedPolicy, &param) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting the %s scheduling class: %s\n",
+                (schedPolicy == SCHED_FIFO) ? "fifo" : "rr", strerror(errno));
+    }
+}
+
+/*
+ * Called first thing by each thread we start
+ */
+void fscGuardThreadInit(void)
+{
+    if (!bGuard)
+        return;
+
+    setScheduler();
+    prefaultStack();
+}
+
+/*
+ * Lock the pages of every mapping we use, apart from large anonymous ones
+ */
+static void prefaultMappings(void)
+{
+    char line[512];
+    char perms[8];
+    unsigned long start, end;
+    int locked = 0, skipped = 0;
+    int pathPos;
+    FILE *fp;
+
+    if ((fp = fopen("/proc/self/maps", "r")) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening /proc/self/maps, memory not pre-faulted\n");
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        pathPos = 0;
+        if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %n", &start, &end, perms, &pathPos) < 3)
+            continue;
+
+        // Guard pages and reservations, and the kernel's own pages
+        if (perms[0] != 'r' || strncmp(line + pathPos, "[v", 2) == 0)
+            continue;
+
+        if ((line[pathPos] == 0 || line[pathPos] == '\n') && end - start > FSC_GUARD_MAX_ANON_PREFAULT) {
+            skipped++;
+            continue;
+        }
+
+        // Unlike mlockall() with MCL_ONFAULT, mlock() faults the range in
+        if (mlock((void *)start, end - start) == 0)
+            locked++;
+    }
+    fclose(fp);
+
+    FSC_LOG(LOG_SEV_INFO, "Pre-faulted %d mappings, left %d large anonymous mappings to fault on use\n", locked, skipped);
+}
+
+/*
+ * Resident, peak and locked memory from /proc/self/status
+ */
+static void reportMemory(const char *when)
+{
+    char line[128];
+    unsigned long rssKb = 0, hwmKb = 0, lockedKb = 0;
+    FILE *fp;
+
+    if ((fp = fopen("/proc/self/status", "r")) == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "VmRSS: %lu", &rssKb) == 1 || sscanf(line, "VmHWM: %lu", &hwmKb) == 1)
+            continue;
+        sscanf(line, "VmLck: %lu", &lockedKb);
+    }
+    fclose(fp);
+
+    FSC_LOG(LOG_SEV_INFO, "Memory %s: %lu kB resident, %lu kB peak, %lu kB in locked mappings\n", when, rssKb, hwmKb, lockedKb);
+}
+
+/*
+ * Protect the process, before any threads are started so their stacks are locked as well
+ */
+void fscGuardInit(void)
+{
+    FILE *fp;
+
+    if (!bGuard)
+        return;
+
+    if ((fp = fopen("/proc/self/oom_score_adj", "w")) == NULL ||
+        fprintf(fp, "%d\n", FSC_GUARD_OOM_SCORE_ADJ) < 0 || fflush(fp) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting oom_score_adj: %s\n", strerror(errno));
+    }
+    if (fp != NULL)
+        fclose(fp);
+
+    setScheduler();
+
+    // Older kernels lack MCL_ONFAULT. Locking the future there would pin every thread stack in
+    // full, so only what is mapped now is locked.
+    if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) != 0 &&
+        (errno != EINVAL || mlockall(MCL_CURRENT) != 0)) {
+        FSC_LOG(LOG_SEV_ERROR, "Error locking memory: %s\n", strerror(errno));
+    }
+}
+
+/*
+ * Fault in the working set once the modules are set up
+ */
+void fscGuardPrefault(void)
+{
+    if (!bGuard)
+        return;
+
+    prefaultStack();
+    prefaultMappings();
+    reportMemory("after pre-faulting");
+}
+
+void fscGuardReport(void)
+{
+    if (bGuard)
+        reportMemory("at exit");
+}
@@ -0,0 +1,347 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscHal.c
+ * @brief Asynchronous platform hal dispatch
+ *
+ * The vendor hal may block for a long time on I2C or MTD accesses, so the hal calls are run on a
+ * dedicated helper thread. Each call has a deadline, failed calls are retried with an exponential
+ * backoff until the deadline or the retry limit is hit, and results and latencies are logged.
+ *
+ * Only the latest request of each kind matters: a newer timeout request replaces one that has not
+ * been dispatched yet, and also cancels the pending retries of the one in flight.
+ *
+ * The hal library is not linked in. Only the two functions we use are resolved with dlopen/dlsym on
+ * the first call, which keeps the large vendor hal out of our startup path. The backend can be
+ * switched at runtime to another library or to the in-tree stub for testing and benchmarking.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+#include "fscMonitor.h"
+
+#define FSC_HAL_LIBRARY "libhal_platform.so"
+// What the old -lhal_platform link recorded as DT_NEEDED, images often ship only this name
+#ifndef FSC_HAL_SONAME
+#define FSC_HAL_SONAME "libhal_platform.so.0"
+#endif
+#define FSC_HAL_STUB_BACKEND "stub"
+
+#define FSC_HAL_MAX_ATTEMPTS 5
+#define FSC_HAL_INITIAL_BACKOFF 1.0
+
+// Per-call deadlines (in seconds)
+#define FSC_HAL_TIMEOUT_DEADLINE 60
+#define FSC_HAL_VALID_DEADLINE 120
+
+typedef enum {
+    FSC_HAL_SET_TIMEOUT,
+    FSC_HAL_SET_VALID,
+    FSC_HAL_NUM_CALLS
+} eFscHalCall;
+
+typedef struct {
+    int arg;
+    double deadline;        // absolute monotonic time
+    BOOLEAN pending;        // queued, not picked up yet
+    BOOLEAN inFlight;       // being run by the helper thread
+    INT result;
+} fscHalRequest_t;
+
+static const char *halCallNames[FSC_HAL_NUM_CALLS] = {
+    "platform_hal_SetDeviceCodeImageTimeout",
+    "platform_hal_SetDeviceCodeImageValid",
+};
+
+typedef INT (*fscHalSetTimeoutFn)(INT seconds);
+typedef INT (*fscHalSetValidFn)(BOOLEAN flag);
+
+static const char *halBackend = FSC_HAL_LIBRARY;
+static void *halHandle = NULL;
+static fscHalSetTimeoutFn halSetTimeout = NULL;
+static fscHalSetValidFn halSetValid = NULL;
+
+static pthread_t halThread;
+static pthread_mutex_t halLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t halCond;
+static fscHalRequest_t halRequests[FSC_HAL_NUM_CALLS];
+static BOOLEAN bHalThreadRunning = FALSE;
+
+static void toTimespec(double t, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)t;
+    ts->tv_nsec = (long)((t - (double)ts->tv_sec) * 1000000000.0);
+}
+
+/*
+ * Resolve the hal functions on first use. Only ever called from the thread running the hal calls.
+ */
+static BOOLEAN halLoad(void)
+{
+    if (halSetTimeout != NULL && halSetValid != NULL)
+        return TRUE;
+
+    if (strcmp(halBackend, FSC_HAL_STUB_BACKEND) == 0) {
+        halSetTimeout = fscHalStubSetImageTimeout;
+        halSetValid = fscHalStubSetImageValid;
+        FSC_LOG(LOG_SEV_INFO, "Using stub hal backend\n");
+        return TRUE;
+    }
+
+    // The default library is looked up by its soname first, the unversioned name is only there
+    // on images which carry the development links
+    if (halHandle == NULL && strcmp(halBackend, FSC_HAL_LIBRARY) == 0) {
+        if ((halHandle = dlopen(FSC_HAL_SONAME, RTLD_LAZY | RTLD_LOCAL)) != NULL)
+            halBackend = FSC_HAL_SONAME;
+        else
+            FSC_LOG(LOG_SEV_WARN, "Error loading %s: %s, trying %s\n", FSC_HAL_SONAME, dlerror(), FSC_HAL_LIBRARY);
+    }
+
+    if (halHandle == NULL && (halHandle = dlopen(halBackend, RTLD_LAZY | RTLD_LOCAL)) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error loading %s: %s\n", halBackend, dlerror());
+        return FALSE;
+    }
+
+    halSetTimeout = (fscHalSetTimeoutFn)dlsym(halHandle, "platform_hal_SetDeviceCodeImageTimeout");
+    halSetValid = (fscHalSetValidFn)dlsym(halHandle, "platform_hal_SetDeviceCodeImageValid");
+
+    if (halSetTimeout == NULL || halSetValid == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error resolving hal functions in %s\n", halBackend);
+        halSetTimeout = NULL;
+        halSetValid = NULL;
+        return FALSE;
+    }
+
+    FSC_LOG(LOG_SEV_INFO, "Loaded hal backend %s\n", halBackend);
+    return TRUE;
+}
+
+static INT halInvoke(eFscHalCall call, int arg)
+{
+    if (!halLoad())
+        return RETURN_ERR;
+
+    if (call == FSC_HAL_SET_TIMEOUT)
+        return halSetTimeout(arg);
+
+    return halSetValid((BOOLEAN)arg);
+}
+
+/*
+ * Run one request with retries, called without the lock held
+ */
+static INT halRun(eFscHalCall call, int arg, double deadline)
+{
+    double backoff = FSC_HAL_INITIAL_BACKOFF;
+    struct timespec ts;
+    double start, latency;
+    BOOLEAN bSuperseded;
+    INT ret = RETURN_ERR;
+    int attempt;
+
+    for (attempt = 1; attempt <= FSC_HAL_MAX_ATTEMPTS; attempt++) {
+        start = fscMonotonicTime();
+        ret = halInvoke(call, arg);
+        latency = fscMonotonicTime() - start;
+        fscMetricsAdd(FSC_METRIC_HAL_CALLS, 1);
+        fscMetricsObserve(FSC_METRIC_HAL_LATENCY, latency);
+        if (ret != RETURN_OK)
+            fscMetricsAdd(FSC_METRIC_HAL_ERRORS, 1);
+
+        FSC_LOG((ret == RETURN_OK) ? LOG_SEV_INFO : LOG_SEV_WARN, "%s(%d) attempt %d returned %d in %.1f ms\n",
+                halCallNames[call], arg, attempt, ret, latency * 1000.0);
+
+        if (ret == RETURN_OK)
+            break;
+
+        if (attempt == FSC_HAL_MAX_ATTEMPTS || fscMonotonicTime() + backoff > deadline) {
+            FSC_LOG(LOG_SEV_ERROR, "%s(%d) failed, giving up after %d attempts\n", halCallNames[call], arg, attempt);
+            break;
+        }
+
+        // Synchronous calls have nothing to be superseded by, and on the virtual clock the back
+        // off must not take real time
+        if (!bHalThreadRunning) {
+            fscClockSleep(backoff);
+            backoff *= 2;
+            continue;
+        }
+
+        // Back off, but drop out early if a newer request of the same kind comes in
+        toTimespec(fscMonotonicTime() + backoff, &ts);
+        pthread_mutex_lock(&halLock);
+        while (!halRequests[call].pending) {
+            if (pthread_cond_timedwait(&halCond, &halLock, &ts) == ETIMEDOUT)
+                break;
+        }
+        bSuperseded = halRequests[call].pending;
+        pthread_mutex_unlock(&halLock);
+
+        if (bSuperseded) {
+            FSC_LOG(LOG_SEV_INFO, "%s(%d) superseded by a newer request\n", halCallNames[call], arg);
+            break;
+        }
+        backoff *= 2;
+    }
+
+    return ret;
+}
+
+static void *halThreadMain(void *arg)
+{
+    fscHalRequest_t req;
+    int call;
+
+    (void)arg;
+
+    // The verdict is delivered from this thread
+    fscGuardThreadInit();
+
+    pthread_mutex_lock(&halLock);
+    for (;;) {
+        for (call = 0; call < FSC_HAL_NUM_CALLS; call++) {
+            if (halRequests[call].pending)
+                break;
+        }
+
+        if (call == FSC_HAL_NUM_CALLS) {
+            pthread_cond_wait(&halCond, &halLock);
+            continue;
+        }
+
+        halRequests[call].pending = FALSE;
+        halRequests[call].inFlight = TRUE;
+        req = halRequests[call];
+        pthread_mutex_unlock(&halLock);
+
+        req.result = halRun((eFscHalCall)call, req.arg, req.deadline);
+
+        pthread_mutex_lock(&halLock);
+        halRequests[call].inFlight = FALSE;
+        halRequests[call].result = req.result;
+        pthread_cond_broadcast(&halCond);
+    }
+
+    return NULL;
+}
+
+/*
+ * Queue a request for the helper thread, falls back to a synchronous call if it is not running
+ */
+static INT halSubmit(eFscHalCall call, int arg, int deadline)
+{
+    if (!bHalThreadRunning)
+        return halRun(call, arg, fscMonotonicTime() + deadline);
+
+    pthread_mutex_lock(&halLock);
+    halRequests[call].arg = arg;
+    halRequests[call].deadline = fscMonotonicTime() + deadline;
+    halRequests[call].pending = TRUE;
+    pthread_cond_broadcast(&halCond);
+    pthread_mutex_unlock(&halLock);
+
+    return RETURN_OK;
+}
+
+/*
+ * Wait for the latest request of a kind to complete, returns its result or RETURN_ERR if the
+ * deadline passed first.
+ */
+static INT halWait(eFscHalCall call, int deadline)
+{
+    struct timespec ts;
+    INT ret = RETURN_ERR;
+
+    toTimespec(fscMonotonicTime() + deadline, &ts);
+
+    pthread_mutex_lock(&halLock);
+    while (halRequests[call].pending || halRequests[call].inFlight) {
+        if (pthread_cond_timedwait(&halCond, &halLock, &ts) == ETIMEDOUT)
+            break;
+    }
+
+    if (halRequests[call].pending || halRequests[call].inFlight) {
+        FSC_LOG(LOG_SEV_ERROR, "%s did not complete within %d seconds\n", halCallNames[call], deadline);
+    } else {
+        ret = halRequests[call].result;
+    }
+    pthread_mutex_unlock(&halLock);
+
+    return ret;
+}
+
+/*
+ * Select the hal backend, either a library name/path or "stub". Must be called before fscHalInit().
+ */
+void fscHalSetBackend(const char *backend)
+{
+    if (backend != NULL && backend[0] != 0)
+        halBackend = backend;
+}
+
+/*
+ * Start the hal helper thread
+ */
+void fscHalInit(void)
+{
+    pthread_condattr_t attr;
+
+    // Calls are made in line on the virtual clock, so replays are deterministic
+    if (fscClockIsVirtual()) {
+        FSC_LOG(LOG_SEV_INFO, "Virtual clock, hal calls will be synchronous\n");
+        return;
+    }
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&halCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&halThread, NULL, halThreadMain, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error starting hal thread, hal calls will be synchronous\n");
+        return;
+    }
+    pthread_detach(halThread);
+    bHalThreadRunning = TRUE;
+}
+
+/*
+ * Tell the hal the image validation expiry time, does not wait for the call to complete
+ */
+INT fscHalSetImageTimeout(INT seconds)
+{
+    return halSubmit(FSC_HAL_SET_TIMEOUT, seconds, FSC_HAL_TIMEOUT_DEADLINE);
+}
+
+/*
+ * Tell the hal whether the image is valid and wait for the verdict to be delivered
+ */
+INT fscHalSetImageValid(BOOLEAN flag)
+{
+    INT ret = halSubmit(FSC_HAL_SET_VALID, flag, FSC_HAL_VALID_DEADLINE);
+
+    if (bHalThreadRunning)
+        ret = halWait(FSC_HAL_SET_VALID, FSC_HAL_VALID_DEADLINE);
+
+    return ret;
+}
@@ -0,0 +1,80 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscHalStub.c
+ * @brief Stub platform hal backend
+ *
+ * Selected with --hal stub or FSC_HAL_BACKEND=stub. The calls are only logged, which allows the
+ * checker to be exercised on a board or host without touching the image banks. The behaviour can
+ * be tuned from the environment:
+ *
+ * FSC_HAL_STUB_DELAY_MS   time each call blocks for
+ * FSC_HAL_STUB_FAILURES   number of calls which return RETURN_ERR before the stub starts succeeding
+ *
+ * A replay changes both as it goes through fscHalStubConfigure().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fscMonitor.h"
+
+static int stubFailures = -1;
+static int stubDelayMs = -1;
+
+static INT stubCall(void)
+{
+    const char *env;
+
+    if (stubFailures < 0)
+        stubFailures = ((env = getenv("FSC_HAL_STUB_FAILURES")) != NULL) ? atoi(env) : 0;
+    if (stubDelayMs < 0)
+        stubDelayMs = ((env = getenv("FSC_HAL_STUB_DELAY_MS")) != NULL) ? atoi(env) : 0;
+
+    if (stubDelayMs > 0)
+        fscClockSleep((double)stubDelayMs / 1000.0);
+
+    if (stubFailures > 0) {
+        stubFailures--;
+        return RETURN_ERR;
+    }
+
+    return RETURN_OK;
+}
+
+INT fscHalStubSetImageTimeout(INT seconds)
+{
+    FSC_LOG(LOG_SEV_INFO, "stub hal: image timeout %d seconds\n", seconds);
+    return stubCall();
+}
+
+INT fscHalStubSetImageValid(BOOLEAN flag)
+{
+    FSC_LOG(LOG_SEV_INFO, "stub hal: image valid %s\n", flag ? "true" : "false");
+    return stubCall();
+}
+
+/*
+ * Set the delay of the following calls and how many of them fail
+ */
+void fscHalStubConfigure(int delayMs, int failures)
+{
+    stubDelayMs = delayMs;
+    stubFailures = failures;
+}
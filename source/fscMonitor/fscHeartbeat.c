@@ -0,0 +1,273 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscHeartbeat.c
+ * @brief Component heartbeat receiver
+ *
+ * Heartbeats are received on a non-blocking datagram socket served from the main event loop. Each
+ * one sets the bit of its component, and once the required set is complete a sample is taken
+ * right away so the verdict does not have to wait for the next sample interval.
+ *
+ * Components which came up before us are found through their marker files at startup. Sender
+ * credentials are passed with every datagram, so heartbeats from other users are ignored.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fscMonitor.h"
+#include "fscHeartbeat.h"
+
+static const char *componentNames[] = {
+    [FSC_COMPONENT_CR]         = "cr",
+    [FSC_COMPONENT_PSM]        = "psm",
+    [FSC_COMPONENT_PAM]        = "pam",
+    [FSC_COMPONENT_WIFI]       = "wifi",
+    [FSC_COMPONENT_CM]         = "cm",
+    [FSC_COMPONENT_TR069]      = "tr069",
+    [FSC_COMPONENT_MTA]        = "mta",
+    [FSC_COMPONENT_MOCA]       = "moca",
+    [FSC_COMPONENT_LM]         = "lm",
+    [FSC_COMPONENT_ETHAGENT]   = "ethagent",
+    [FSC_COMPONENT_WANMANAGER] = "wanmanager",
+};
+#define NUM_COMPONENT_NAMES (int)(sizeof(componentNames) / sizeof(componentNames[0]))
+
+static uint32_t requiredComponents = 0;
+static uint32_t reportedComponents = 0;
+static int heartbeatFd = -1;
+
+/*
+ * Set the required components from a comma separated list of names, returns -1 on an unknown name
+ */
+int fscHeartbeatSetRequired(const char *list)
+{
+    char buf[256];
+    char *name, *save = NULL;
+    int i;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    requiredComponents = 0;
+
+    for (name = strtok_r(buf, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        for (i = 0; i < NUM_COMPONENT_NAMES; i++) {
+            if (componentNames[i] != NULL && strcmp(name, componentNames[i]) == 0)
+                break;
+        }
+        if (i == NUM_COMPONENT_NAMES) {
+            fprintf(stderr, "Unknown component %s\n", name);
+            return -1;
+        }
+        requiredComponents |= 1u << i;
+    }
+
+    return 0;
+}
+
+/*
+ * Check to see if all required components have reported in. Always TRUE if none are required.
+ */
+BOOLEAN fscHeartbeatsComplete(void)
+{
+    return (reportedComponents & requiredComponents) == requiredComponents;
+}
+
+static void componentReported(uint32_t component, uint32_t pid)
+{
+    fscStatus_t *status;
+    uint32_t bit = 1u << component;
+
+    if (reportedComponents & bit)
+        return;
+
+    reportedComponents |= bit;
+    fscNoteProgress();
+    FSC_LOG(LOG_SEV_INFO, "Component %s (pid %u) reported in\n",
+            ((int)component < NUM_COMPONENT_NAMES && componentNames[component]) ? componentNames[component] : "unknown",
+            pid);
+
+    status = fscStatusBeginUpdate();
+    status->components = reportedComponents;
+    fscStatusEndUpdate();
+
+    // The last required component just came up, no need to wait for the next sample
+    if ((bit & requiredComponents) && fscHeartbeatsComplete()) {
+        FSC_LOG(LOG_SEV_INFO, "All required components reported in\n");
+        fscRequestRecheck();
+    }
+}
+
+/*
+ * Only root and our own user may report components
+ */
+static BOOLEAN heartbeatSenderAllowed(uid_t uid)
+{
+    return uid == 0 || uid == geteuid();
+}
+
+static void heartbeatHandle(int fd, uint32_t events, void *ctx)
+{
+    fscHeartbeat_t hb;
+    struct ucred *cred;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct ucred))];
+    } control;
+    ssize_t len;
+
+    (void)events;
+    (void)ctx;
+
+    for (;;) {
+        iov.iov_base = &hb;
+        iov.iov_len = sizeof(hb);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        if ((len = recvmsg(fd, &msg, MSG_DONTWAIT)) < 0)
+            break;
+
+        if (len != (ssize_t)sizeof(hb) || hb.magic != FSC_HEARTBEAT_MAGIC ||
+            hb.component >= FSC_COMPONENT_MAX || hb.state != FSC_HEARTBEAT_UP) {
+            continue;
+        }
+
+        cred = NULL;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS)
+                cred = (struct ucred *)CMSG_DATA(cmsg);
+        }
+        if (cred == NULL || !heartbeatSenderAllowed(cred->uid)) {
+            FSC_LOG(LOG_SEV_WARN, "Heartbeat for component %u from uid %d ignored\n", hb.component,
+                    (cred != NULL) ? (int)cred->uid : -1);
+            continue;
+        }
+
+        componentReported(hb.component, (uint32_t)cred->pid);
+    }
+}
+
+/*
+ * Pick up the components which reported in before the socket was there
+ */
+static void heartbeatReadMarkers(void)
+{
+    char marker[FSC_ROOT_PATH_LEN];
+    char path[FSC_ROOT_PATH_LEN];
+    const char *file;
+    struct stat st;
+    uint32_t component;
+
+    for (component = 0; component < FSC_COMPONENT_MAX; component++) {
+        snprintf(marker, sizeof(marker), FSC_HEARTBEAT_MARKER, (unsigned int)component);
+        file = fscRootPath(marker, path, sizeof(path));
+        if (lstat(file, &st) != 0)
+            continue;
+
+        if (!S_ISREG(st.st_mode) || !heartbeatSenderAllowed(st.st_uid)) {
+            FSC_LOG(LOG_SEV_WARN, "Heartbeat marker %s owned by uid %u ignored\n", file, (unsigned int)st.st_uid);
+            continue;
+        }
+
+        componentReported(component, 0);
+    }
+}
+
+/*
+ * A replayed heartbeat, returns -1 on an unknown component name
+ */
+int fscHeartbeatInject(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_COMPONENT_NAMES; i++) {
+        if (componentNames[i] != NULL && strcmp(name, componentNames[i]) == 0) {
+            componentReported((uint32_t)i, 0);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Create the heartbeat socket and register it with the event loop
+ */
+void fscHeartbeatInit(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    struct sockaddr_un addr;
+    int on = 1;
+
+    if ((heartbeatFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating heartbeat socket: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fscRootPath(FSC_HEARTBEAT_SOCKET, path, sizeof(path)));
+    unlink(addr.sun_path);
+
+    if (setsockopt(heartbeatFd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) != 0 ||
+        bind(heartbeatFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        fscLoopAdd(heartbeatFd, EPOLLIN, heartbeatHandle, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting up heartbeat socket %s: %s\n", addr.sun_path, strerror(errno));
+        close(heartbeatFd);
+        heartbeatFd = -1;
+        // Components could never report in, do not hold the image hostage to that
+        requiredComponents = 0;
+        return;
+    }
+
+    // After the bind, so a component coming up right now is caught one way or the other
+    heartbeatReadMarkers();
+
+    if (requiredComponents != 0 && !fscHeartbeatsComplete())
+        FSC_LOG(LOG_SEV_INFO, "Waiting for required components 0x%x\n", requiredComponents);
+}
+
+/*
+ * Remove the heartbeat socket
+ */
+void fscHeartbeatShutdown(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+
+    if (heartbeatFd < 0)
+        return;
+
+    fscLoopRemove(heartbeatFd);
+    close(heartbeatFd);
+    unlink(fscRootPath(FSC_HEARTBEAT_SOCKET, path, sizeof(path)));
+    heartbeatFd = -1;
+}
@@ -0,0 +1,81 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscHeartbeat.h
+ * @brief Component heartbeat channel
+ *
+ * CCSP components announce that they are up by sending a single fixed size datagram to fscMonitor.
+ * fscMonitor keeps a bitmap of the components which reported in, and can be configured to require
+ * a set of them before the image is declared valid.
+ *
+ * Components should link libfscstatus and call fscHeartbeatSend() once they are initialized.
+ * Besides the datagram it leaves a marker file, which fscMonitor picks up when it starts, so a
+ * component which comes up before fscMonitor is not lost. Markers live in /tmp and so last until
+ * the next boot. Heartbeats and markers only count when they come from root or fscMonitor's user.
+ */
+
+#ifndef FSC_HEARTBEAT_H
+#define FSC_HEARTBEAT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FSC_HEARTBEAT_SOCKET "/tmp/fscMonitor.hb"
+#define FSC_HEARTBEAT_MARKER "/tmp/fscMonitor.hb.%u"  // component number
+#define FSC_HEARTBEAT_MAGIC 0x4648 /* "FH" */
+
+typedef enum {
+    FSC_COMPONENT_CR,
+    FSC_COMPONENT_PSM,
+    FSC_COMPONENT_PAM,
+    FSC_COMPONENT_WIFI,
+    FSC_COMPONENT_CM,
+    FSC_COMPONENT_TR069,
+    FSC_COMPONENT_MTA,
+    FSC_COMPONENT_MOCA,
+    FSC_COMPONENT_LM,
+    FSC_COMPONENT_ETHAGENT,
+    FSC_COMPONENT_WANMANAGER,
+    FSC_COMPONENT_MAX = 32      // components are tracked in a 32 bit map
+} eFscComponent;
+
+typedef enum {
+    FSC_HEARTBEAT_UP = 1
+} eFscHeartbeatState;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t component;          // eFscComponent
+    uint8_t state;              // eFscHeartbeatState
+    uint32_t pid;
+} fscHeartbeat_t;
+
+/*
+ * Tell fscMonitor that a component is up, returns 0 on success or -1 if fscMonitor is not listening
+ */
+int fscHeartbeatSend(eFscComponent component);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSC_HEARTBEAT_H */
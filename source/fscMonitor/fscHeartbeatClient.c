@@ -0,0 +1,64 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscHeartbeatClient.c
+ * @brief Sender side of the component heartbeat channel
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fscHeartbeat.h"
+#include "fscRoot.h"
+
+int fscHeartbeatSend(eFscComponent component)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    char marker[FSC_ROOT_PATH_LEN];
+    struct sockaddr_un addr;
+    fscHeartbeat_t hb;
+    ssize_t len;
+    int fd, markerFd;
+
+    // The marker covers the case where fscMonitor is not listening yet
+    snprintf(marker, sizeof(marker), FSC_HEARTBEAT_MARKER, (unsigned int)component);
+    if ((markerFd = open(fscRootPath(marker, path, sizeof(path)), O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0644)) >= 0)
+        close(markerFd);
+
+    if ((fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+        return (markerFd >= 0) ? 0 : -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fscRootPath(FSC_HEARTBEAT_SOCKET, path, sizeof(path)));
+
+    hb.magic = FSC_HEARTBEAT_MAGIC;
+    hb.component = (uint8_t)component;
+    hb.state = FSC_HEARTBEAT_UP;
+    hb.pid = (uint32_t)getpid();
+
+    len = sendto(fd, &hb, sizeof(hb), MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *)&addr, sizeof(addr));
+    close(fd);
+
+    return (len == (ssize_t)sizeof(hb) || markerFd >= 0) ? 0 : -1;
+}
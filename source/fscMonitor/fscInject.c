@@ -0,0 +1,455 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscInject.c
+ * @brief Latency and error injection shim
+ *
+ * Preloaded into fscMonitor to see whether the verdict still reaches the hal in time when flash
+ * I/O stalls or the hal blocks, on an ordinary Linux box:
+ *
+ *   LD_PRELOAD=libfscinject.so FSC_INJECT="stat:2000:0:/tmp/;hal:30000:50" fscMonitor --hal libfscinject.so
+ *
+ * FSC_INJECT is a ';' separated list of rules "<call>:<delay ms>:<error percent>[:<match>]" for
+ * the calls stat, open, read and hal. stat covers lstat as well, open covers openat and
+ * fopen, read covers pread and only applies to regular files, so sockets and event descriptors are
+ * left alone. The 64 bit variants a _FILE_OFFSET_BITS=64 build calls on 32 bit targets are covered,
+ * and so are the __xstat family which glibc before 2.33 turns stat into. The match limits stat and
+ * open to paths starting with it. Failed calls return -1 with EIO, fopen returns NULL and the hal
+ * calls return RETURN_ERR. FSC_INJECT_SEED makes the errors repeatable.
+ *
+ * With FSC_INJECT_SKEW=1 the delays are not slept but added to what clock_gettime returns from
+ * then on, so a stall of minutes costs no real time. This is meant for replays, whose virtual
+ * clock counts the time spent in a sample, and where the hal calls are made in line.
+ *
+ * fscMonitor does not link the hal but loads it with dlopen, so the shim doubles as a hal backend:
+ * with --hal libfscinject.so its platform_hal_* functions apply the hal rule and then forward to
+ * the library named by FSC_INJECT_HAL, or succeed if there is none.
+ *
+ * The daemon logs how far ahead of the hal deadline the verdict was delivered, and
+ * FSC_DEADLINE_MISSED if it was not. The shim is built by make check, which replays the traces in
+ * test/stress with it and skewed time using test/stressInject.sh.
+ */
+
+// Both the plain and the 64 bit entry points are defined here, neither may be renamed to the other
+#undef _FILE_OFFSET_BITS
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "platform_hal.h"
+
+#define FSC_INJECT_MAX_RULES 16
+#define FSC_INJECT_MATCH_LEN 128
+
+typedef enum {
+    FSC_INJECT_STAT,
+    FSC_INJECT_OPEN,
+    FSC_INJECT_READ,
+    FSC_INJECT_HAL,
+    FSC_INJECT_NUM_CALLS
+} eFscInjectCall;
+
+static const char *callNames[FSC_INJECT_NUM_CALLS] = { "stat", "open", "read", "hal" };
+
+typedef struct {
+    eFscInjectCall call;
+    int delayMs;
+    int errorPercent;
+    char match[FSC_INJECT_MATCH_LEN];
+} fscInjectRule_t;
+
+static fscInjectRule_t rules[FSC_INJECT_MAX_RULES];
+static int numRules = 0;
+static unsigned int callMask = 0;
+static uint64_t randState = 0x2545f4914f6cdd1dULL;
+static int bSkew = 0;
+static int64_t skewNs = 0;      // injected delay so far with FSC_INJECT_SKEW
+
+static int (*realStat)(const char *, struct stat *);
+static int (*realLstat)(const char *, struct stat *);
+static int (*realStat64)(const char *, struct stat64 *);
+static int (*realLstat64)(const char *, struct stat64 *);
+static int (*realOpen)(const char *, int, ...);
+static int (*realOpen64)(const char *, int, ...);
+static int (*realOpenat)(int, const char *, int, ...);
+static int (*realOpenat64)(int, const char *, int, ...);
+static FILE *(*realFopen)(const char *, const char *);
+static FILE *(*realFopen64)(const char *, const char *);
+static ssize_t (*realRead)(int, void *, size_t);
+static ssize_t (*realPread)(int, void *, size_t, off_t);
+static ssize_t (*realPread64)(int, void *, size_t, off64_t);
+static int (*realClockGettime)(clockid_t, struct timespec *);
+
+#define RESOLVE(fn, name) do { if ((fn) == NULL) (fn) = dlsym(RTLD_NEXT, name); } while (0)
+
+__attribute__((constructor))
+static void injectInit(void)
+{
+    char spec[1024];
+    char *rule, *save = NULL;
+    fscInjectRule_t *r;
+    const char *env;
+    char name[16];
+    int i, n;
+
+    if ((env = getenv("FSC_INJECT_SEED")) != NULL)
+        randState = strtoull(env, NULL, 0) | 1;
+    if ((env = getenv("FSC_INJECT_SKEW")) != NULL)
+        bSkew = atoi(env) != 0;
+
+    if ((env = getenv("FSC_INJECT")) == NULL)
+        return;
+
+    snprintf(spec, sizeof(spec), "%s", env);
+    for (rule = strtok_r(spec, ";", &save); rule != NULL && numRules < FSC_INJECT_MAX_RULES;
+         rule = strtok_r(NULL, ";", &save)) {
+        r = &rules[numRules];
+        memset(r, 0, sizeof(*r));
+        n = 0;
+        if (sscanf(rule, "%15[^:]:%d:%d%n", name, &r->delayMs, &r->errorPercent, &n) != 3) {
+            fprintf(stderr, "fscinject: bad rule %s\n", rule);
+            continue;
+        }
+        if (rule[n] == ':')
+            snprintf(r->match, sizeof(r->match), "%s", rule + n + 1);
+
+        for (i = 0; i < FSC_INJECT_NUM_CALLS; i++) {
+            if (strcmp(name, callNames[i]) == 0)
+                break;
+        }
+        if (i == FSC_INJECT_NUM_CALLS) {
+            fprintf(stderr, "fscinject: unknown call %s\n", name);
+            continue;
+        }
+
+        r->call = (eFscInjectCall)i;
+        callMask |= 1u << i;
+        numRules++;
+    }
+}
+
+static unsigned int randPercent(void)
+{
+    // xorshift64*, races between threads only make it more random
+    randState ^= randState >> 12;
+    randState ^= randState << 25;
+    randState ^= randState >> 27;
+    return (unsigned int)(((randState * 0x2545f4914f6cdd1dULL) >> 32) % 100);
+}
+
+/*
+ * Apply the first rule for the call which matches, returns TRUE if the call is to fail
+ */
+static int inject(eFscInjectCall call, const char *subject)
+{
+    struct timespec ts;
+    fscInjectRule_t *r;
+    int i;
+
+    if (!(callMask & (1u << call)))
+        return 0;
+
+    for (i = 0; i < numRules; i++) {
+        r = &rules[i];
+        if (r->call != call)
+            continue;
+        if (r->match[0] != 0) {
+            if (subject == NULL)
+                continue;
+            if (strncmp(subject, r->match, strlen(r->match)) != 0)
+                continue;
+        }
+
+        if (r->delayMs > 0 && bSkew) {
+            __atomic_add_fetch(&skewNs, (int64_t)r->delayMs * 1000000, __ATOMIC_RELAXED);
+        } else if (r->delayMs > 0) {
+            ts.tv_sec = r->delayMs / 1000;
+            ts.tv_nsec = (long)(r->delayMs % 1000) * 1000000L;
+            while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+                ;
+        }
+        return r->errorPercent > 0 && randPercent() < (unsigned int)r->errorPercent;
+    }
+
+    return 0;
+}
+
+static int isRegular(int fd)
+{
+    struct stat st;
+
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/*
+ * TRUE with errno set if a call on path is to fail
+ */
+static int failPath(eFscInjectCall call, const char *path)
+{
+    if (!inject(call, path))
+        return 0;
+    errno = EIO;
+    return 1;
+}
+
+static int failRead(int fd)
+{
+    if (!(callMask & (1u << FSC_INJECT_READ)) || !isRegular(fd) || !inject(FSC_INJECT_READ, NULL))
+        return 0;
+    errno = EIO;
+    return 1;
+}
+
+// The mode argument of open and openat is only there with O_CREAT or O_TMPFILE
+#define OPEN_MODE(flags, mode) \
+    do { \
+        va_list args; \
+        if ((flags) & (O_CREAT | O_TMPFILE)) { \
+            va_start(args, flags); \
+            (mode) = va_arg(args, mode_t); \
+            va_end(args); \
+        } \
+    } while (0)
+
+int stat(const char *path, struct stat *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realStat, "stat");
+    return realStat(path, st);
+}
+
+int lstat(const char *path, struct stat *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realLstat, "lstat");
+    return realLstat(path, st);
+}
+
+int stat64(const char *path, struct stat64 *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realStat64, "stat64");
+    return realStat64(path, st);
+}
+
+int lstat64(const char *path, struct stat64 *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realLstat64, "lstat64");
+    return realLstat64(path, st);
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 33)
+/*
+ * Before glibc 2.33 stat and friends are inline wrappers around these
+ */
+static int (*realXstat)(int, const char *, struct stat *);
+static int (*realLxstat)(int, const char *, struct stat *);
+static int (*realXstat64)(int, const char *, struct stat64 *);
+static int (*realLxstat64)(int, const char *, struct stat64 *);
+
+int __xstat(int ver, const char *path, struct stat *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realXstat, "__xstat");
+    return realXstat(ver, path, st);
+}
+
+int __lxstat(int ver, const char *path, struct stat *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realLxstat, "__lxstat");
+    return realLxstat(ver, path, st);
+}
+
+int __xstat64(int ver, const char *path, struct stat64 *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realXstat64, "__xstat64");
+    return realXstat64(ver, path, st);
+}
+
+int __lxstat64(int ver, const char *path, struct stat64 *st)
+{
+    if (failPath(FSC_INJECT_STAT, path))
+        return -1;
+    RESOLVE(realLxstat64, "__lxstat64");
+    return realLxstat64(ver, path, st);
+}
+#endif
+
+int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    OPEN_MODE(flags, mode);
+    if (failPath(FSC_INJECT_OPEN, path))
+        return -1;
+    RESOLVE(realOpen, "open");
+    return realOpen(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    OPEN_MODE(flags, mode);
+    if (failPath(FSC_INJECT_OPEN, path))
+        return -1;
+    RESOLVE(realOpen64, "open64");
+    return realOpen64(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    OPEN_MODE(flags, mode);
+    if (failPath(FSC_INJECT_OPEN, path))
+        return -1;
+    RESOLVE(realOpenat, "openat");
+    return realOpenat(dirfd, path, flags, mode);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    OPEN_MODE(flags, mode);
+    if (failPath(FSC_INJECT_OPEN, path))
+        return -1;
+    RESOLVE(realOpenat64, "openat64");
+    return realOpenat64(dirfd, path, flags, mode);
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+    if (failPath(FSC_INJECT_OPEN, path))
+        return NULL;
+    RESOLVE(realFopen, "fopen");
+    return realFopen(path, mode);
+}
+
+FILE *fopen64(const char *path, const char *mode)
+{
+    if (failPath(FSC_INJECT_OPEN, path))
+        return NULL;
+    RESOLVE(realFopen64, "fopen64");
+    return realFopen64(path, mode);
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    if (failRead(fd))
+        return -1;
+    RESOLVE(realRead, "read");
+    return realRead(fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+    if (failRead(fd))
+        return -1;
+    RESOLVE(realPread, "pread");
+    return realPread(fd, buf, count, offset);
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset)
+{
+    if (failRead(fd))
+        return -1;
+    RESOLVE(realPread64, "pread64");
+    return realPread64(fd, buf, count, offset);
+}
+
+/*
+ * Skewed time, the cpu time clocks are left alone
+ */
+int clock_gettime(clockid_t id, struct timespec *ts)
+{
+    int64_t skew;
+    int ret;
+
+    RESOLVE(realClockGettime, "clock_gettime");
+    if ((ret = realClockGettime(id, ts)) != 0 || id == CLOCK_PROCESS_CPUTIME_ID || id == CLOCK_THREAD_CPUTIME_ID || id < 0)
+        return ret;
+
+    if ((skew = __atomic_load_n(&skewNs, __ATOMIC_RELAXED)) > 0) {
+        ts->tv_sec += (time_t)(skew / 1000000000);
+        ts->tv_nsec += (long)(skew % 1000000000);
+        if (ts->tv_nsec >= 1000000000L) {
+            ts->tv_sec++;
+            ts->tv_nsec -= 1000000000L;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Hal backend, see above
+ */
+static void *halLibrary(void)
+{
+    static void *handle = NULL;
+    const char *lib;
+
+    if (handle == NULL && (lib = getenv("FSC_INJECT_HAL")) != NULL && lib[0] != 0)
+        handle = dlopen(lib, RTLD_NOW | RTLD_LOCAL);
+    return handle;
+}
+
+INT platform_hal_SetDeviceCodeImageTimeout(INT seconds)
+{
+    INT (*fn)(INT);
+    void *handle;
+
+    if (inject(FSC_INJECT_HAL, NULL))
+        return RETURN_ERR;
+    if ((handle = halLibrary()) != NULL && (fn = (INT (*)(INT))dlsym(handle, "platform_hal_SetDeviceCodeImageTimeout")) != NULL)
+        return fn(seconds);
+    return RETURN_OK;
+}
+
+INT platform_hal_SetDeviceCodeImageValid(BOOLEAN flag)
+{
+    INT (*fn)(BOOLEAN);
+    void *handle;
+
+    if (inject(FSC_INJECT_HAL, NULL))
+        return RETURN_ERR;
+    if ((handle = halLibrary()) != NULL && (fn = (INT (*)(BOOLEAN))dlsym(handle, "platform_hal_SetDeviceCodeImageValid")) != NULL)
+        return fn(flag);
+    return RETURN_OK;
+}
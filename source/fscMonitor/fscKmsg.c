@@ -0,0 +1,256 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscKmsg.c
+ * @brief Kernel log watcher
+ *
+ * Follows /dev/kmsg from the event loop, starting with the oldest record of this boot, and runs
+ * every record through a precompiled multi-pattern matcher to count oopses, panics, OOM kills,
+ * lockups and warnings. The fd is non-blocking and each wakeup drains the pending records, so
+ * bursts during boot are kept up with; records the kernel overwrote before we got to them are
+ * detected from the sequence numbers and counted as dropped.
+ *
+ * An oops or panic, or repeated OOM kills, fail the image through the fatal probes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "fscMonitor.h"
+
+#define FSC_KMSG_FILE "/dev/kmsg"
+
+// Largest record the kernel hands out in one read
+#define FSC_KMSG_RECORD_MAX 8192
+
+// Records handled per wakeup, the rest is picked up on the next one
+#define FSC_KMSG_BATCH 256
+
+// This many OOM kills during the check fail the image
+#define FSC_KMSG_OOM_LIMIT 3
+
+// Matching records which are logged, the counts keep going after that
+#define FSC_KMSG_LOG_LIMIT 16
+
+static const struct {
+    const char *pattern;
+    int class;
+} kmsgPatterns[] = {
+    { "Oops:",                  FSC_KMSG_OOPS },
+    { "Oops - BUG",             FSC_KMSG_OOPS },
+    { "kernel BUG at",          FSC_KMSG_OOPS },
+    { "Kernel panic",           FSC_KMSG_PANIC },
+    { "Killed process",         FSC_KMSG_OOM },
+    { "soft lockup",            FSC_KMSG_LOCKUP },
+    { "hard LOCKUP",            FSC_KMSG_LOCKUP },
+    { "blocked for more than",  FSC_KMSG_LOCKUP },
+    { "detected stalls on CPU", FSC_KMSG_LOCKUP },
+    { "WARNING: CPU:",          FSC_KMSG_WARNING },
+    { "WARNING: at",            FSC_KMSG_WARNING },
+};
+
+#define FSC_KMSG_NUM_PATTERNS (int)(sizeof(kmsgPatterns) / sizeof(kmsgPatterns[0]))
+
+static const char *classNames[FSC_KMSG_NUM_CLASSES] = { "oops", "panic", "oom", "lockup", "warning" };
+
+static fscMatcher_t *matcher = NULL;
+static uint32_t classMask[FSC_KMSG_NUM_CLASSES];
+static uint32_t counts[FSC_KMSG_NUM_CLASSES];
+static unsigned long long lastSeq = 0;
+static BOOLEAN bSeqValid = FALSE;
+static uint32_t dropped = 0;
+static int logged = 0;
+static int kmsgFd = -1;
+
+/*
+ * Match one record: "<prio>,<seq>,<usec>,<flags>[,...];<message>\n[ KEY=value\n]..."
+ */
+static void handleRecord(char *record, size_t len)
+{
+    unsigned long long seq;
+    unsigned int prio;
+    char *message, *end;
+    uint32_t seen;
+    int i;
+
+    record[len] = 0;
+    if (sscanf(record, "%u,%llu,", &prio, &seq) != 2)
+        return;
+
+    if (bSeqValid && seq > lastSeq + 1) {
+        dropped += (uint32_t)(seq - lastSeq - 1);
+        fscMetricsAdd(FSC_METRIC_KMSG_DROPPED, seq - lastSeq - 1);
+    }
+    lastSeq = seq;
+    bSeqValid = TRUE;
+
+    // Only kernel messages count, userspace can write to /dev/kmsg as well
+    if ((prio >> 3) != 0)
+        return;
+
+    if ((message = strchr(record, ';')) == NULL)
+        return;
+    message++;
+    if ((end = strchr(message, '\n')) != NULL)
+        *end = 0;
+
+    if ((seen = fscMatchScan(matcher, NULL, message, strlen(message), NULL, NULL)) == 0)
+        return;
+
+    for (i = 0; i < FSC_KMSG_NUM_CLASSES; i++) {
+        if (seen & classMask[i])
+            counts[i]++;
+    }
+
+    if (logged < FSC_KMSG_LOG_LIMIT) {
+        FSC_LOG(LOG_SEV_WARN, "Kernel: %s\n", message);
+        logged++;
+    }
+}
+
+static void kmsgHandle(int fd, uint32_t events, void *ctx)
+{
+    static char record[FSC_KMSG_RECORD_MAX + 1];
+    ssize_t len;
+    int n;
+
+    (void)events;
+    (void)ctx;
+
+    for (n = 0; n < FSC_KMSG_BATCH; n++) {
+        len = read(fd, record, FSC_KMSG_RECORD_MAX);
+        if (len < 0) {
+            // The record we were about to read was overwritten, the next read continues with the
+            // oldest one still there and the sequence gap tells how many were lost
+            if (errno == EPIPE || errno == EINTR)
+                continue;
+            break;
+        }
+        if (len == 0)
+            break;
+
+        fscMetricsAdd(FSC_METRIC_KMSG_RECORDS, 1);
+        handleRecord(record, (size_t)len);
+    }
+}
+
+/*
+ * Compile the patterns and start following the kernel log
+ */
+void fscKmsgInit(void)
+{
+    const char *patterns[FSC_KMSG_NUM_PATTERNS];
+    int i;
+
+    for (i = 0; i < FSC_KMSG_NUM_PATTERNS; i++) {
+        patterns[i] = kmsgPatterns[i].pattern;
+        classMask[kmsgPatterns[i].class] |= 1u << i;
+    }
+
+    if ((matcher = fscMatchCompile(patterns, FSC_KMSG_NUM_PATTERNS, 0)) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error compiling the kernel log patterns\n");
+        return;
+    }
+
+    // A replay feeds its own kernel messages, the log of this host does not count
+    if (fscReplayActive())
+        return;
+
+    if ((kmsgFd = open(FSC_KMSG_FILE, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening %s, kernel log not watched\n", FSC_KMSG_FILE);
+        return;
+    }
+
+    if (fscLoopAdd(kmsgFd, EPOLLIN, kmsgHandle, NULL) != 0) {
+        close(kmsgFd);
+        kmsgFd = -1;
+        return;
+    }
+
+    // Catch up with everything logged since boot before the first sample
+    kmsgHandle(kmsgFd, EPOLLIN, NULL);
+}
+
+/*
+ * A replayed kernel message
+ */
+void fscKmsgInject(const char *message)
+{
+    char record[FSC_KMSG_RECORD_MAX + 1];
+    int len;
+
+    if (matcher == NULL)
+        return;
+
+    len = snprintf(record, sizeof(record), "2,%llu,0,-;%s\n", bSeqValid ? lastSeq + 1 : 0, message);
+    if (len < 0 || len >= (int)sizeof(record))
+        return;
+
+    fscMetricsAdd(FSC_METRIC_KMSG_RECORDS, 1);
+    handleRecord(record, (size_t)len);
+}
+
+/*
+ * Number of kernel log events of a class seen since boot
+ */
+uint32_t fscKmsgCount(int class)
+{
+    return counts[class];
+}
+
+/*
+ * Kernel oopsed or panicked, or keeps killing processes for lack of memory
+ */
+BOOLEAN fscKmsgCheckFatal(char *reason, size_t len)
+{
+    if (counts[FSC_KMSG_OOPS] > 0 || counts[FSC_KMSG_PANIC] > 0) {
+        snprintf(reason, len, "kernel log reports %u oops and %u panic", counts[FSC_KMSG_OOPS], counts[FSC_KMSG_PANIC]);
+        return TRUE;
+    }
+
+    if (counts[FSC_KMSG_OOM] >= FSC_KMSG_OOM_LIMIT) {
+        snprintf(reason, len, "kernel log reports %u OOM kills", counts[FSC_KMSG_OOM]);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Log the event counts at the end of the check
+ */
+void fscKmsgReport(void)
+{
+    int i;
+
+    if (kmsgFd < 0)
+        return;
+
+    for (i = 0; i < FSC_KMSG_NUM_CLASSES; i++) {
+        if (counts[i] > 0)
+            FSC_LOG(LOG_SEV_INFO, "Kernel log: %u %s events\n", counts[i], classNames[i]);
+    }
+    if (dropped > 0)
+        FSC_LOG(LOG_SEV_WARN, "Kernel log: %u records overwritten before they were read\n", dropped);
+}
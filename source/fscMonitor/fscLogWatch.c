@@ -0,0 +1,381 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscLogWatch.c
+ * @brief RDK log file follower
+ *
+ * Follows a configured set of log files, by default in /rdklogs/logs, and runs everything which
+ * gets appended to them through the multi-pattern matcher for known fatal strings. The directories
+ * of the files are watched with inotify, so nothing is read until a file changes, and then only the
+ * bytes appended since the last read. The matcher state is carried between reads, so a string
+ * split over two writes is still found.
+ *
+ * Rotation is handled by tracking the inode behind each path: when the path points to a new file,
+ * the rest of the old one is read first and the new one is followed from its start. Files which
+ * are truncated in place are followed from their start again. /rdklogs is in RAM, so the files
+ * are read from the start when we come up and the whole boot is covered.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+
+#include "fscMonitor.h"
+
+#define FSC_LOG_WATCH_DIR "/rdklogs/logs"
+#define FSC_LOG_WATCH_MAX_FILES 16
+#define FSC_LOG_WATCH_PATH_LEN 256
+#define FSC_LOG_WATCH_PATTERN_LEN 128
+#define FSC_LOG_WATCH_CHUNK (64 * 1024)
+
+// Matching lines which are logged, the counts keep going after that
+#define FSC_LOG_WATCH_LOG_LIMIT 16
+
+// Strings which show up in the logs when a process crashes
+static const char *defaultPatterns[] = {
+    "Segmentation fault",
+    "SIGSEGV",
+    "SIGABRT",
+    "SIGBUS",
+    "core dumped",
+    "stack smashing detected",
+    "double free or corruption",
+};
+
+typedef struct {
+    char path[FSC_LOG_WATCH_PATH_LEN];
+    const char *name;           // file name within its directory
+    int wd;                     // inotify watch of the directory
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    off_t offset;               // bytes read so far
+    uint32_t state;             // matcher state at offset
+} fscLogFile_t;
+
+typedef struct {
+    const fscLogFile_t *file;
+    const char *chunk;
+    size_t len;
+} fscLogChunk_t;
+
+static fscLogFile_t files[FSC_LOG_WATCH_MAX_FILES];
+static int numFiles = 0;
+static char patterns[FSC_MATCH_MAX_PATTERNS][FSC_LOG_WATCH_PATTERN_LEN];
+static int numPatterns = 0;
+static uint32_t counts[FSC_MATCH_MAX_PATTERNS];
+static uint32_t totalMatches = 0;
+static int logged = 0;
+static BOOLEAN bFailOnMatch = FALSE;
+static fscMatcher_t *matcher = NULL;
+static int inotifyFd = -1;
+
+/*
+ * Count a match and log the line it is on, as far as it is within the chunk
+ */
+static int matchHandle(int pattern, size_t end, void *ctx)
+{
+    const fscLogChunk_t *chunk = ctx;
+    size_t len, start, stop;
+
+    counts[pattern]++;
+    totalMatches++;
+    fscMetricsAdd(FSC_METRIC_LOG_MATCHES, 1);
+
+    if (logged < FSC_LOG_WATCH_LOG_LIMIT) {
+        for (stop = end; stop < chunk->len && chunk->chunk[stop] != '\n'; stop++)
+            ;
+        len = fscMatchPatternLength(matcher, pattern);
+        if (end < len) {
+            // The match began in an earlier read, whose text is gone
+            FSC_LOG(LOG_SEV_WARN, "%s: ...%s%.*s\n", chunk->file->name, patterns[pattern],
+                    (int)(stop - end), chunk->chunk + end);
+        } else {
+            for (start = end - len; start > 0 && chunk->chunk[start - 1] != '\n'; start--)
+                ;
+            FSC_LOG(LOG_SEV_WARN, "%s: %.*s\n", chunk->file->name, (int)(stop - start), chunk->chunk + start);
+        }
+        logged++;
+    }
+
+    return 0;
+}
+
+/*
+ * Scan everything appended since the last read
+ */
+static void readAppended(fscLogFile_t *f)
+{
+    static char buf[FSC_LOG_WATCH_CHUNK];
+    fscLogChunk_t chunk;
+    ssize_t n;
+
+    chunk.file = f;
+    chunk.chunk = buf;
+
+    while ((n = pread(f->fd, buf, sizeof(buf), f->offset)) > 0) {
+        chunk.len = (size_t)n;
+        fscMatchScan(matcher, &f->state, buf, (size_t)n, matchHandle, &chunk);
+        fscMetricsAdd(FSC_METRIC_LOG_BYTES, n);
+        f->offset += n;
+    }
+}
+
+/*
+ * Catch up with a file, switching over to a new file if the path was rotated
+ */
+static void followFile(fscLogFile_t *f)
+{
+    struct stat st;
+
+    if (f->fd >= 0) {
+        // Truncated in place, start over
+        if (fstat(f->fd, &st) == 0 && st.st_size < f->offset) {
+            f->offset = 0;
+            f->state = 0;
+        }
+        readAppended(f);
+    }
+
+    if (stat(f->path, &st) != 0 || (f->fd >= 0 && st.st_dev == f->dev && st.st_ino == f->ino))
+        return;
+
+    // Path is new or was rotated, the old file has been read up to its end above
+    if (f->fd >= 0)
+        close(f->fd);
+    if ((f->fd = open(f->path, O_RDONLY | O_CLOEXEC)) < 0 || fstat(f->fd, &st) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening %s \n", f->path);
+        if (f->fd >= 0)
+            close(f->fd);
+        f->fd = -1;
+        return;
+    }
+
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->offset = 0;
+    f->state = 0;
+    readAppended(f);
+}
+
+static void inotifyHandle(int fd, uint32_t events, void *ctx)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t len;
+    char *p;
+    int i;
+
+    (void)events;
+    (void)ctx;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)p;
+
+            for (i = 0; i < numFiles; i++) {
+                // Events were lost, catch up with everything
+                if ((ev->mask & IN_Q_OVERFLOW) ||
+                    (ev->wd == files[i].wd && ev->len > 0 && strcmp(ev->name, files[i].name) == 0))
+                    followFile(&files[i]);
+            }
+        }
+    }
+}
+
+/*
+ * Log files to follow, names without a directory are taken from /rdklogs/logs under the root
+ */
+int fscLogWatchSetFiles(const char *list)
+{
+    char buf[1024];
+    char *name, *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    numFiles = 0;
+
+    for (name = strtok_r(buf, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        if (numFiles == FSC_LOG_WATCH_MAX_FILES) {
+            fprintf(stderr, "Too many log files, at most %d can be followed\n", FSC_LOG_WATCH_MAX_FILES);
+            return -1;
+        }
+
+        // Bare names are completed by fscLogWatchInit(), once the root directory is known
+        snprintf(files[numFiles].path, FSC_LOG_WATCH_PATH_LEN, "%s", name);
+        files[numFiles].fd = -1;
+        files[numFiles].wd = -1;
+        numFiles++;
+    }
+
+    return 0;
+}
+
+/*
+ * Read the patterns to look for from a file, one per line, instead of the built in ones
+ */
+int fscLogWatchSetPatterns(const char *file)
+{
+    char line[FSC_LOG_WATCH_PATTERN_LEN];
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return -1;
+    }
+
+    numPatterns = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0 || line[0] == '#')
+            continue;
+
+        if (numPatterns == FSC_MATCH_MAX_PATTERNS) {
+            fprintf(stderr, "Too many patterns in %s, at most %d are supported\n", file, FSC_MATCH_MAX_PATTERNS);
+            fclose(fp);
+            return -1;
+        }
+        snprintf(patterns[numPatterns++], FSC_LOG_WATCH_PATTERN_LEN, "%s", line);
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+/*
+ * Fail the image as soon as any of the patterns shows up
+ */
+void fscLogWatchSetFail(BOOLEAN bFail)
+{
+    bFailOnMatch = bFail;
+}
+
+/*
+ * Compile the patterns, watch the directories and catch up with the files
+ */
+void fscLogWatchInit(void)
+{
+    const char *list[FSC_MATCH_MAX_PATTERNS];
+    char dir[FSC_LOG_WATCH_PATH_LEN];
+    char path[FSC_LOG_WATCH_PATH_LEN];
+    int i;
+
+    if (numFiles == 0)
+        return;
+
+    for (i = 0; i < numFiles; i++) {
+        if (strchr(files[i].path, '/') == NULL) {
+            if (snprintf(path, sizeof(path), "%s/%s", fscRootPath(FSC_LOG_WATCH_DIR, dir, sizeof(dir)), files[i].path) >= (int)sizeof(path))
+                FSC_LOG(LOG_SEV_WARN, "Log file path %s is truncated\n", path);
+            memcpy(files[i].path, path, sizeof(path));
+        }
+        files[i].name = strrchr(files[i].path, '/') + 1;
+    }
+
+    if (numPatterns == 0) {
+        for (i = 0; i < (int)(sizeof(defaultPatterns) / sizeof(defaultPatterns[0])); i++)
+            snprintf(patterns[numPatterns++], FSC_LOG_WATCH_PATTERN_LEN, "%s", defaultPatterns[i]);
+    }
+    for (i = 0; i < numPatterns; i++)
+        list[i] = patterns[i];
+
+    if ((matcher = fscMatchCompile(list, numPatterns, 0)) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error compiling the log patterns\n");
+        return;
+    }
+
+    if ((inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0 ||
+        fscLoopAdd(inotifyFd, EPOLLIN, inotifyHandle, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting up inotify, log files not followed\n");
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+
+    for (i = 0; i < numFiles; i++) {
+        // Watching the directory catches files which are created or rotated later on
+        snprintf(dir, sizeof(dir), "%.*s", (int)(files[i].name - files[i].path - 1), files[i].path);
+        if ((files[i].wd = inotify_add_watch(inotifyFd, dir[0] ? dir : "/", IN_MODIFY | IN_CREATE | IN_MOVED_TO)) < 0)
+            FSC_LOG(LOG_SEV_ERROR, "Error watching %s for %s \n", dir, files[i].name);
+
+        followFile(&files[i]);
+    }
+
+    FSC_LOG(LOG_SEV_INFO, "Following %d log files for %d patterns\n", numFiles, numPatterns);
+}
+
+/*
+ * Stop following the files
+ */
+void fscLogWatchShutdown(void)
+{
+    int i;
+
+    if (inotifyFd >= 0) {
+        fscLoopRemove(inotifyFd);
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+
+    for (i = 0; i < numFiles; i++) {
+        if (files[i].fd >= 0) {
+            close(files[i].fd);
+            files[i].fd = -1;
+        }
+    }
+}
+
+/*
+ * One of the fatal strings showed up in the logs
+ */
+BOOLEAN fscLogWatchCheckFatal(char *reason, size_t len)
+{
+    int i;
+
+    if (!bFailOnMatch || totalMatches == 0)
+        return FALSE;
+
+    for (i = 0; i < numPatterns; i++) {
+        if (counts[i] > 0) {
+            snprintf(reason, len, "logs report \"%s\" %u times", patterns[i], counts[i]);
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Log the match counts at the end of the check
+ */
+void fscLogWatchReport(void)
+{
+    int i;
+
+    for (i = 0; i < numPatterns; i++) {
+        if (counts[i] > 0)
+            FSC_LOG(LOG_SEV_INFO, "Logs: \"%s\" seen %u times\n", patterns[i], counts[i]);
+    }
+}
@@ -0,0 +1,247 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscLoop.c
+ * @brief Main event loop
+ *
+ * A minimal epoll based loop. Modules register the file descriptors they want to be woken up for
+ * together with a handler, and the main routine runs the loop in between samples instead of
+ * sleeping.
+ *
+ * Timers are kept by the loop itself rather than as timerfds, so they run on fscMonotonicTime()
+ * and follow the virtual clock as well. Their precision is that of the epoll timeout, which is
+ * plenty for timers of a second and up.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "fscMonitor.h"
+
+#define FSC_LOOP_MAX_HANDLERS 32
+#define FSC_LOOP_MAX_EVENTS 16
+#define FSC_LOOP_MAX_TIMERS 8
+
+typedef struct {
+    int fd;
+    fscLoopHandler_t handler;
+    void *ctx;
+} fscLoopEntry_t;
+
+typedef struct {
+    fscLoopTimerHandler_t handler;  // NULL if the slot is free
+    void *ctx;
+    double due;                     // monotonic time, 0 while disarmed
+    double interval;
+} fscLoopTimer_t;
+
+static int epollFd = -1;
+static fscLoopEntry_t loopEntries[FSC_LOOP_MAX_HANDLERS];
+static fscLoopTimer_t loopTimers[FSC_LOOP_MAX_TIMERS];
+
+/*
+ * Create the epoll instance
+ */
+void fscLoopInit(void)
+{
+    int i;
+
+    for (i = 0; i < FSC_LOOP_MAX_HANDLERS; i++)
+        loopEntries[i].fd = -1;
+
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        FSC_LOG(LOG_SEV_ERROR, "Error creating epoll instance: %s\n", strerror(errno));
+}
+
+/*
+ * Watch a file descriptor, returns 0 on success or -1 on failure
+ */
+int fscLoopAdd(int fd, uint32_t events, fscLoopHandler_t handler, void *ctx)
+{
+    struct epoll_event ev;
+    int i;
+
+    if (epollFd < 0)
+        return -1;
+
+    for (i = 0; i < FSC_LOOP_MAX_HANDLERS; i++) {
+        if (loopEntries[i].fd < 0)
+            break;
+    }
+    if (i == FSC_LOOP_MAX_HANDLERS) {
+        FSC_LOG(LOG_SEV_ERROR, "Too many event loop handlers\n");
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = &loopEntries[i];
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error adding fd %d to the event loop: %s\n", fd, strerror(errno));
+        return -1;
+    }
+
+    loopEntries[i].fd = fd;
+    loopEntries[i].handler = handler;
+    loopEntries[i].ctx = ctx;
+    return 0;
+}
+
+/*
+ * Stop watching a file descriptor, must be called before the descriptor is closed
+ */
+void fscLoopRemove(int fd)
+{
+    int i;
+
+    if (epollFd < 0)
+        return;
+
+    for (i = 0; i < FSC_LOOP_MAX_HANDLERS; i++) {
+        if (loopEntries[i].fd == fd) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+            loopEntries[i].fd = -1;
+            break;
+        }
+    }
+}
+
+/*
+ * Create a disarmed timer, returns its id or -1
+ */
+int fscLoopTimerAdd(fscLoopTimerHandler_t handler, void *ctx)
+{
+    int i;
+
+    for (i = 0; i < FSC_LOOP_MAX_TIMERS; i++) {
+        if (loopTimers[i].handler == NULL) {
+            loopTimers[i].handler = handler;
+            loopTimers[i].ctx = ctx;
+            loopTimers[i].due = 0;
+            return i;
+        }
+    }
+
+    FSC_LOG(LOG_SEV_ERROR, "Too many event loop timers\n");
+    return -1;
+}
+
+/*
+ * Fire a timer delay seconds from now, and every interval seconds after that unless interval is 0
+ */
+void fscLoopTimerArm(int timer, double delay, double interval)
+{
+    if (timer < 0)
+        return;
+
+    loopTimers[timer].due = fscMonotonicTime() + delay;
+    loopTimers[timer].interval = interval;
+}
+
+void fscLoopTimerDisarm(int timer)
+{
+    if (timer >= 0)
+        loopTimers[timer].due = 0;
+}
+
+void fscLoopTimerRemove(int timer)
+{
+    if (timer >= 0)
+        loopTimers[timer].handler = NULL;
+}
+
+/*
+ * Shorten a timeout to the first timer due
+ */
+static int timerTimeout(double now, int timeoutMs)
+{
+    double wait;
+    int i, ms;
+
+    for (i = 0; i < FSC_LOOP_MAX_TIMERS; i++) {
+        if (loopTimers[i].handler == NULL || loopTimers[i].due == 0)
+            continue;
+
+        wait = (loopTimers[i].due - now) * 1000.0;
+        ms = (wait > 0) ? (int)wait + 1 : 0;
+        if (timeoutMs < 0 || ms < timeoutMs)
+            timeoutMs = ms;
+    }
+
+    return timeoutMs;
+}
+
+static void runTimers(double now)
+{
+    fscLoopTimer_t *timer;
+    int i;
+
+    for (i = 0; i < FSC_LOOP_MAX_TIMERS; i++) {
+        timer = &loopTimers[i];
+        if (timer->handler == NULL || timer->due == 0 || timer->due > now)
+            continue;
+
+        // Expirations missed while the loop was busy are not made up for
+        if (timer->interval > 0) {
+            timer->due += timer->interval;
+            if (timer->due <= now)
+                timer->due = now + timer->interval;
+        } else {
+            timer->due = 0;
+        }
+
+        timer->handler(timer->ctx);
+    }
+}
+
+/*
+ * Wait up to timeoutMs for events and dispatch them, then run the timers which are due
+ */
+void fscLoopRun(int timeoutMs)
+{
+    struct epoll_event events[FSC_LOOP_MAX_EVENTS];
+    fscLoopEntry_t *entry;
+    int n = 0, i;
+
+    timeoutMs = timerTimeout(fscMonotonicTime(), timeoutMs);
+
+    if (epollFd < 0) {
+        poll(NULL, 0, fscClockBlockMs(timeoutMs));
+    } else {
+        n = epoll_wait(epollFd, events, FSC_LOOP_MAX_EVENTS, fscClockBlockMs(timeoutMs));
+        fscMetricsAdd(FSC_METRIC_WAKEUPS, 1);
+    }
+
+    if (n == 0)
+        fscClockIdle(timeoutMs);
+
+    for (i = 0; i < n; i++) {
+        entry = (fscLoopEntry_t *)events[i].data.ptr;
+
+        // The handler of an earlier event may have removed this one
+        if (entry->fd >= 0)
+            entry->handler(entry->fd, events[i].events, entry->ctx);
+    }
+
+    runTimers(fscMonotonicTime());
+}
@@ -0,0 +1,215 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscMatch.c
+ * @brief Multi-pattern matcher
+ *
+ * Aho-Corasick automaton compiled into a dense DFA, so a buffer is scanned in a single pass with
+ * one table lookup per byte regardless of the number of patterns. Bytes are first mapped to
+ * equivalence classes (every byte which does not occur in a pattern shares one class), which
+ * keeps the transition table small enough to stay in cache.
+ *
+ * The scan state can be carried across calls, so a stream can be fed in arbitrary pieces and
+ * matches straddling two pieces are still found.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "fscMonitor.h"
+
+#define FSC_MATCH_OUTPUT 0x80000000u
+
+struct fscMatcher {
+    int numStates;
+    int numClasses;
+    int numPatterns;
+    uint8_t classOf[256];
+    uint32_t *delta;            // numStates x numClasses transitions to the start of the target row,
+                                // FSC_MATCH_OUTPUT is set if the target state has output
+    uint32_t *output;           // patterns ending in each state, fail chain included
+    size_t patternLen[FSC_MATCH_MAX_PATTERNS];
+};
+
+/*
+ * Compile up to FSC_MATCH_MAX_PATTERNS patterns, pattern i reports bit i. Returns NULL on error.
+ */
+fscMatcher_t *fscMatchCompile(const char *const *patterns, int count, int flags)
+{
+    fscMatcher_t *m;
+    int *fail = NULL, *queue = NULL;
+    uint16_t *trie = NULL;
+    int maxStates = 1;
+    int head = 0, tail = 0;
+    int i, c, s, t;
+    size_t j;
+
+    if (count <= 0 || count > FSC_MATCH_MAX_PATTERNS)
+        return NULL;
+
+    if ((m = calloc(1, sizeof(*m))) == NULL)
+        return NULL;
+
+    // Class 0 is every byte which does not occur in any pattern
+    m->numClasses = 1;
+    m->numPatterns = count;
+    for (i = 0; i < count; i++) {
+        m->patternLen[i] = strlen(patterns[i]);
+        maxStates += (int)m->patternLen[i];
+
+        for (j = 0; j < m->patternLen[i]; j++) {
+            uint8_t b = (uint8_t)patterns[i][j];
+
+            if (flags & FSC_MATCH_NOCASE)
+                b = (uint8_t)tolower(b);
+            if (m->classOf[b] == 0) {
+                m->classOf[b] = (uint8_t)m->numClasses++;
+                if (flags & FSC_MATCH_NOCASE)
+                    m->classOf[toupper(b)] = m->classOf[b];
+            }
+        }
+    }
+
+    if (maxStates > UINT16_MAX || m->numClasses > 255)
+        goto fail;
+
+    trie = calloc((size_t)maxStates * m->numClasses, sizeof(uint16_t));
+    m->output = calloc((size_t)maxStates, sizeof(uint32_t));
+    fail = calloc((size_t)maxStates, sizeof(int));
+    queue = calloc((size_t)maxStates, sizeof(int));
+    if (trie == NULL || m->output == NULL || fail == NULL || queue == NULL)
+        goto fail;
+
+    // Trie of all patterns, 0 means no transition while building since nothing goes back to root
+    m->numStates = 1;
+    for (i = 0; i < count; i++) {
+        s = 0;
+        for (j = 0; j < m->patternLen[i]; j++) {
+            c = m->classOf[(uint8_t)patterns[i][j]];
+            if (trie[s * m->numClasses + c] == 0)
+                trie[s * m->numClasses + c] = (uint16_t)m->numStates++;
+            s = trie[s * m->numClasses + c];
+        }
+        m->output[s] |= 1u << i;
+    }
+
+    // Breadth first: fail links, inherited outputs and the missing transitions of the DFA
+    for (c = 0; c < m->numClasses; c++) {
+        if ((t = trie[c]) != 0) {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        s = queue[head++];
+        for (c = 0; c < m->numClasses; c++) {
+            t = trie[s * m->numClasses + c];
+            if (t != 0) {
+                fail[t] = trie[fail[s] * m->numClasses + c];
+                m->output[t] |= m->output[fail[t]];
+                queue[tail++] = t;
+            } else {
+                trie[s * m->numClasses + c] = trie[fail[s] * m->numClasses + c];
+            }
+        }
+    }
+
+    // Premultiplied row offsets save a multiply in the scan loop
+    if ((m->delta = malloc((size_t)m->numStates * m->numClasses * sizeof(uint32_t))) == NULL)
+        goto fail;
+    for (s = 0; s < m->numStates * m->numClasses; s++) {
+        t = trie[s];
+        m->delta[s] = (uint32_t)(t * m->numClasses) | (m->output[t] ? FSC_MATCH_OUTPUT : 0);
+    }
+
+    free(trie);
+    free(fail);
+    free(queue);
+    return m;
+
+fail:
+    free(trie);
+    free(fail);
+    free(queue);
+    fscMatchFree(m);
+    return NULL;
+}
+
+void fscMatchFree(fscMatcher_t *m)
+{
+    if (m == NULL)
+        return;
+
+    free(m->delta);
+    free(m->output);
+    free(m);
+}
+
+/*
+ * Length of pattern i, end - length is where a reported match starts
+ */
+size_t fscMatchPatternLength(const fscMatcher_t *m, int pattern)
+{
+    return m->patternLen[pattern];
+}
+
+/*
+ * Scan a buffer, returns the bitmap of all patterns seen. state carries the automaton across
+ * calls and may be NULL for a single buffer. The optional handler is called for every match with
+ * the offset just past its end, and stops the scan by returning non-zero.
+ */
+uint32_t fscMatchScan(const fscMatcher_t *m, uint32_t *state, const char *buf, size_t len,
+                      fscMatchHandler_t handler, void *ctx)
+{
+    const uint32_t *delta = m->delta;
+    const uint8_t *classOf = m->classOf;
+    const int numClasses = m->numClasses;
+    uint32_t s = state ? *state : 0;
+    uint32_t seen = 0;
+    uint32_t t, out;
+    size_t i;
+    int p;
+
+    for (i = 0; i < len; i++) {
+        t = delta[s + classOf[(uint8_t)buf[i]]];
+        s = t & ~FSC_MATCH_OUTPUT;
+        if (!(t & FSC_MATCH_OUTPUT))
+            continue;
+
+        out = m->output[s / numClasses];
+
+        seen |= out;
+        if (handler == NULL)
+            continue;
+
+        for (p = 0; out != 0; p++, out >>= 1) {
+            if ((out & 1) && handler(p, i + 1, ctx) != 0) {
+                if (state)
+                    *state = s;
+                return seen;
+            }
+        }
+    }
+
+    if (state)
+        *state = s;
+    return seen;
+}
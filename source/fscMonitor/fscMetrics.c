@@ -0,0 +1,220 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscMetrics.c
+ * @brief Metrics registry
+ *
+ * Counters and fixed bucket histograms updated with atomic operations, so they can be bumped from
+ * the hal thread as well as from the main loop. A client connecting to the metrics socket gets the
+ * registry rendered in the Prometheus text exposition format, after which the connection is closed.
+ * Rendering goes into a static buffer so a scrape never allocates.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fscMonitor.h"
+
+#define FSC_METRICS_SOCKET "/tmp/fscMonitor.metrics"
+#define FSC_METRICS_BUFFER_SIZE 8192
+#define FSC_METRICS_NUM_BUCKETS 7
+
+typedef struct {
+    const char *name;
+    const char *help;
+} fscMetricInfo_t;
+
+typedef struct {
+    uint64_t buckets[FSC_METRICS_NUM_BUCKETS];
+    uint64_t count;
+    uint64_t sumUs;
+} fscHistogram_t;
+
+static const fscMetricInfo_t counterInfo[FSC_METRIC_NUM_COUNTERS] = {
+    { "fsc_polls_total",        "Number of samples taken" },
+    { "fsc_wakeups_total",      "Number of event loop wakeups" },
+    { "fsc_bytes_read_total",   "Bytes read from files" },
+    { "fsc_hal_calls_total",    "Number of platform hal calls" },
+    { "fsc_hal_errors_total",   "Number of failed platform hal calls" },
+    { "fsc_kmsg_records_total", "Number of kernel log records read" },
+    { "fsc_kmsg_dropped_total", "Kernel log records overwritten before they were read" },
+    { "fsc_log_bytes_total",    "Bytes scanned from followed log files" },
+    { "fsc_log_matches_total",  "Fatal strings found in followed log files" },
+    { "fsc_sample_overruns_total", "Samples which took longer than the sample interval" },
+};
+
+static const fscMetricInfo_t histogramInfo[FSC_METRIC_NUM_HISTOGRAMS] = {
+    { "fsc_xconf_parse_seconds", "Time taken to check the xconf response" },
+    { "fsc_hal_latency_seconds", "Latency of platform hal calls" },
+    { "fsc_sample_seconds",      "Time taken by one sample" },
+};
+
+// Upper bounds of the histogram buckets in seconds, the last bucket is +Inf
+static const double bucketBounds[FSC_METRICS_NUM_BUCKETS - 1] = { 0.0001, 0.001, 0.01, 0.1, 1, 10 };
+static const char *bucketLabels[FSC_METRICS_NUM_BUCKETS] = { "0.0001", "0.001", "0.01", "0.1", "1", "10", "+Inf" };
+
+static uint64_t counters[FSC_METRIC_NUM_COUNTERS];
+static fscHistogram_t histograms[FSC_METRIC_NUM_HISTOGRAMS];
+
+static char renderBuffer[FSC_METRICS_BUFFER_SIZE];
+static size_t renderLen;
+static int listenFd = -1;
+
+void fscMetricsAdd(eFscCounter counter, uint64_t value)
+{
+    __atomic_fetch_add(&counters[counter], value, __ATOMIC_RELAXED);
+}
+
+void fscMetricsObserve(eFscHistogram histogram, double seconds)
+{
+    fscHistogram_t *h = &histograms[histogram];
+    int i;
+
+    for (i = 0; i < FSC_METRICS_NUM_BUCKETS - 1; i++) {
+        if (seconds <= bucketBounds[i])
+            break;
+    }
+
+    __atomic_fetch_add(&h->buckets[i], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sumUs, (uint64_t)(seconds * 1000000.0), __ATOMIC_RELAXED);
+}
+
+static void renderAppend(const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (renderLen >= sizeof(renderBuffer))
+        return;
+
+    va_start(args, fmt);
+    n = vsnprintf(renderBuffer + renderLen, sizeof(renderBuffer) - renderLen, fmt, args);
+    va_end(args);
+
+    renderLen = (n < 0) ? sizeof(renderBuffer) : renderLen + (size_t)n;
+    if (renderLen > sizeof(renderBuffer))
+        renderLen = sizeof(renderBuffer);
+}
+
+/*
+ * Render the registry into the static buffer, returns the length of the text
+ */
+static size_t metricsRender(void)
+{
+    const fscStatus_t *status = fscStatusCurrent();
+    uint64_t cumulative;
+    int i, b;
+
+    renderLen = 0;
+
+    for (i = 0; i < FSC_METRIC_NUM_COUNTERS; i++) {
+        renderAppend("# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counterInfo[i].name, counterInfo[i].help,
+                     counterInfo[i].name, counterInfo[i].name,
+                     (unsigned long long)__atomic_load_n(&counters[i], __ATOMIC_RELAXED));
+    }
+
+    for (i = 0; i < FSC_METRIC_NUM_HISTOGRAMS; i++) {
+        const char *name = histogramInfo[i].name;
+
+        renderAppend("# HELP %s %s\n# TYPE %s histogram\n", name, histogramInfo[i].help, name);
+        cumulative = 0;
+        for (b = 0; b < FSC_METRICS_NUM_BUCKETS; b++) {
+            cumulative += __atomic_load_n(&histograms[i].buckets[b], __ATOMIC_RELAXED);
+            renderAppend("%s_bucket{le=\"%s\"} %llu\n", name, bucketLabels[b], (unsigned long long)cumulative);
+        }
+        renderAppend("%s_sum %.6f\n%s_count %llu\n",
+                     name, (double)__atomic_load_n(&histograms[i].sumUs, __ATOMIC_RELAXED) / 1000000.0,
+                     name, (unsigned long long)__atomic_load_n(&histograms[i].count, __ATOMIC_RELAXED));
+    }
+
+    renderAppend("# HELP fsc_phase Phase of the check (0 starting, 1 checking, 2 done)\n# TYPE fsc_phase gauge\nfsc_phase %u\n", status->phase);
+    renderAppend("# HELP fsc_verdict Verdict (0 pending, 1 valid, 2 invalid)\n# TYPE fsc_verdict gauge\nfsc_verdict %u\n", status->verdict);
+    renderAppend("# HELP fsc_elapsed_seconds Time since the check started\n# TYPE fsc_elapsed_seconds gauge\nfsc_elapsed_seconds %u\n", status->elapsed);
+    renderAppend("# HELP fsc_remaining_seconds Time until the check expires\n# TYPE fsc_remaining_seconds gauge\nfsc_remaining_seconds %u\n", status->remaining);
+
+    return renderLen;
+}
+
+static void metricsHandleListen(int fd, uint32_t events, void *ctx)
+{
+    size_t len;
+    int clientFd;
+
+    (void)events;
+    (void)ctx;
+
+    while ((clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        // The text is well below the socket buffer size, so a single non-blocking send will do
+        len = metricsRender();
+        if (send(clientFd, renderBuffer, len, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)len)
+            FSC_LOG(LOG_SEV_WARN, "Short write to metrics client\n");
+        close(clientFd);
+    }
+}
+
+/*
+ * Create the metrics socket and register it with the event loop
+ */
+void fscMetricsInit(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    struct sockaddr_un addr;
+
+    if ((listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating metrics socket: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fscRootPath(FSC_METRICS_SOCKET, path, sizeof(path)));
+    unlink(addr.sun_path);
+
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, 4) != 0 ||
+        fscLoopAdd(listenFd, EPOLLIN, metricsHandleListen, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting up metrics socket %s: %s\n", addr.sun_path, strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+/*
+ * Remove the metrics socket
+ */
+void fscMetricsShutdown(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+
+    if (listenFd < 0)
+        return;
+
+    fscLoopRemove(listenFd);
+    close(listenFd);
+    unlink(fscRootPath(FSC_METRICS_SOCKET, path, sizeof(path)));
+    listenFd = -1;
+}
@@ -36,92 +36,114 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <stdarg.h>
+#include <getopt.h>
 
 #define FSC_DEBUG_FILE "/nvram/forceFSC"
+#define FSC_XCONF_RESPONSE_FILE "/tmp/response.txt"
 
-typedef enum {
-    LOG_SEV_ERROR,
-    LOG_SEV_WARN,
-    LOG_SEV_INFO
-} eLogSeverity;
+#include "fscMonitor.h"
 
 #ifdef FEATURE_SUPPORT_RDKLOG
-#include "ccsp_trace.h"
 char compName[25]="LOG.RDK.FSC";
 #define DEBUG_INI_NAME  "/etc/debug.ini"
-#define FSC_LOG(x, ...) { if((x)==(LOG_SEV_INFO)){CcspTraceInfo((__VA_ARGS__));}else if((x)==(LOG_SEV_WARN)){CcspTraceWarning((__VA_ARGS__));}else if((x)==(LOG_SEV_ERROR)){CcspTraceError((__VA_ARGS__));} }
-#else
-// Log macros
-#define FSC_LOG(x, fmt, args...) \
-    { \
-        struct tm *gtime; time_t now; \
-        char buf[80]; \
-        time(&now); gtime = gmtime(&now); \
-        strftime(buf,80,"%y%m%d-%H:%M:%S",gtime); \
-        fprintf(stderr, "%s [FSC_LOG] %s(), " fmt, \
-                buf,__FUNCTION__,##args); fflush(stderr); \
-    }
 #endif
 
-// We need to put this after the ccsp_trace.h above, since it re-defines CHAR
-#include "platform_hal.h"
-
-// 60 minute timeout value (in seconds), but we will shift the time by 5 minutes to account for the startup offset.
-#define FSC_TIMEOUT_VALUE 60*60
-
-const int sampleInterval = 30;
-const int timeOffset = 300;
 BOOLEAN bDebugOverride = FALSE;
 BOOLEAN bIsProduction = FALSE;
+BOOLEAN bProgressMode = FALSE;
+BOOLEAN bFastFail = TRUE;
+BOOLEAN bRecheckRequested = FALSE;
+BOOLEAN bRequireProcesses = FALSE;
+BOOLEAN bBootPerfFail = FALSE;
+BOOLEAN bProgressNoted = FALSE;
+eFscXconfResult xconfResult = FSC_XCONF_NONE;
 
 #define DATA_SIZE 1024
 
+/*
+ * Files which are created or updated as the stack comes up. Any of these appearing or changing
+ * between two samples is treated as forward progress in progress-aware mode.
+ */
+static const char *progressMarkers[] = {
+    "/tmp/psm_initialized",
+    "/tmp/pam_initialized",
+    "/tmp/wifi_initialized",
+    "/tmp/response.txt",
+    NULL
+};
+static time_t progressMtime[sizeof(progressMarkers) / sizeof(progressMarkers[0])];
+
 
 /*
- * Check to see if a file exists
+ * Check to see if a file exists under the root
  */
 BOOLEAN doesFileExist(const char *filename) {
+    char path[FSC_ROOT_PATH_LEN];
     struct stat st;
-    int result = stat(filename, &st);
+    int result = stat(fscRootPath(filename, path, sizeof(path)), &st);
     return result == 0;
 }
 
+/*
+ * Read the imagename of the running image from version.txt
+ */
+BOOLEAN fscGetImageName(char *name, size_t len)
+{
+    FILE *fp;
+    char line[DATA_SIZE];
+    char path[FSC_ROOT_PATH_LEN];
+    BOOLEAN bFound = FALSE;
+
+    if ((fp = fopen(fscRootPath("/fss/gw/version.txt", path, sizeof(path)), "r")) == NULL &&
+        (fp = fopen(fscRootPath("/version.txt", path, sizeof(path)), "r")) == NULL) {
+        return FALSE;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "imagename", 9) == 0 && (line[9] == ':' || line[9] == '=')) {
+            line[strcspn(line, "\r\n")] = 0;
+            snprintf(name, len, "%s", line + 10);
+            bFound = TRUE;
+            break;
+        }
+    }
+    fclose(fp);
+
+    return bFound;
+}
+
 /*
  * Check to see if this is a production image
  */
 BOOLEAN isProductionImage()
 {
-	FILE *fp;
     char buf[DATA_SIZE] = {0};
-	char cmd[DATA_SIZE] = {0};
+    char name[DATA_SIZE] = {0};
+    char *field;
 	BOOLEAN isProd = FALSE;
 
 
     // Check the location of version.txt file
-    if (doesFileExist("/fss/gw/version.txt"))
-    {
-    	sprintf(cmd, "cat /fss/gw/version.txt | grep '^imagename' | sed 's/imagename[:=]//' | cut -f2 -d'_'");
-    } else if (doesFileExist("/version.txt")) {
-    	sprintf(cmd, "cat /version.txt | grep '^imagename' | sed 's/imagename[:=]//' | cut -f2 -d'_'");
-    } else {
+    if (!doesFileExist("/fss/gw/version.txt") && !doesFileExist("/version.txt")) {
         // Version file not found, should we mark this as bad?
         FSC_LOG(LOG_SEV_ERROR, "Error version.txt file not found! \n");
         return TRUE;
     }
 
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        /* Could not run command should we mark image as bad? */
-    	FSC_LOG(LOG_SEV_ERROR, "Error opening command pipe! \n");
-    	return TRUE;
+    // Second '_' separated field of the imagename, or all of it if there is no '_', as a line the
+    // way the shell pipeline which used to do this printed it
+    if (fscGetImageName(name, sizeof(name))) {
+        field = strchr(name, '_');
+        field = (field != NULL) ? field + 1 : name;
+        snprintf(buf, sizeof(buf), "%.*s\n", (int)strcspn(field, "_"), field);
     }
-
-    fgets(buf, DATA_SIZE, fp);
+    fscMetricsAdd(FSC_METRIC_BYTES_READ, strlen(buf));
 
     if ( buf[0] != 0 && strcmp(buf, "PROD") == 0 ) {
         FSC_LOG(LOG_SEV_INFO, "Production image detected, FSC check active\n");
@@ -130,11 +152,6 @@ BOOLEAN isProductionImage()
         FSC_LOG(LOG_SEV_INFO, "Debug/VBN image detected\n");
     }
 
-    if (pclose(fp) != 0) {
-        /* Error reported by pclose() */
-    	FSC_LOG(LOG_SEV_ERROR, "Error closing command pipe! \n");
-    }
-
     return isProd;
 }
 
@@ -143,45 +160,32 @@ BOOLEAN isProductionImage()
  */
 BOOLEAN validXConfResponse()
 {
-	FILE *fp;
-    char buf[DATA_SIZE] = {0};
-	char cmd[DATA_SIZE] = {0};
-	BOOLEAN isValid = FALSE;
-
-	if (doesFileExist("/tmp/response.txt")) {
-        // We'll check for a couple responses in the file to make sure that we have an actual firmware
-	    // filename to fetch.
-        // If this is in the file, the xconf server does not recognize us
-	    // sprintf(cmd1, "cat /tmp/response.txt | grep -o '404 NOT FOUND'");
-
-	    // Otherwise there should be a firmware name in the file
-        sprintf(cmd, "cat /tmp/response.txt | grep -o '\"firmwareFilename[^,]*' | sed 's/\"firmwareFilename\"://'");
-
-        fp = popen(cmd, "r");
-        if (fp == NULL) {
-            /* Could not run command mark image as bad? */
-            FSC_LOG(LOG_SEV_ERROR, "Error opening command pipe! \n");
-            return FALSE;
-        }
-
-        fgets(buf, DATA_SIZE, fp);
+    char firmware[128] = {0};
+    char path[FSC_ROOT_PATH_LEN];
 
-        if (buf[0] != 0 && strlen(buf) > 0) {
-            FSC_LOG(LOG_SEV_INFO, "XConf reported a firmware name of %s \n", buf);
-            isValid = TRUE;
-        } else {
-            FSC_LOG(LOG_SEV_WARN, "XConf response exists, but did not respond with a valid firmware image name! \n");
-        }
+    // A single pass over the response picks out the firmware name as well as the 404 and error
+    // markers which tell why there is none
+    xconfResult = fscXconfClassifyFile(fscRootPath(FSC_XCONF_RESPONSE_FILE, path, sizeof(path)), firmware, sizeof(firmware));
 
-        if (pclose(fp) != 0) {
-            /* Error reported by pclose() */
-            FSC_LOG(LOG_SEV_ERROR, "Error closing command pipe! \n");
-        }
-	} else {
+    switch (xconfResult) {
+    case FSC_XCONF_VALID:
+        FSC_LOG(LOG_SEV_INFO, "XConf reported a firmware name of %s \n", firmware);
+        return TRUE;
+    case FSC_XCONF_NONE:
         FSC_LOG(LOG_SEV_WARN, "Xconf response file does not exist yet, xconf has not responded \n");
-	}
+        break;
+    case FSC_XCONF_UNKNOWN_DEVICE:
+        FSC_LOG(LOG_SEV_WARN, "XConf response exists, but the xconf server does not recognize us! \n");
+        break;
+    case FSC_XCONF_PARTIAL:
+        FSC_LOG(LOG_SEV_WARN, "XConf response is incomplete, xconf is still responding \n");
+        break;
+    default:
+        FSC_LOG(LOG_SEV_WARN, "XConf response exists, but did not respond with a valid firmware image name! \n");
+        break;
+    }
 
-    return isValid;
+    return FALSE;
 }
 
 /*
@@ -189,9 +193,22 @@ BOOLEAN validXConfResponse()
  */
 BOOLEAN checkXconfValid()
 {
+    char path[FSC_ROOT_PATH_LEN];
+
     // Fetch xconf response
+    double start = fscMonotonicTime();
     BOOLEAN bValidXconf = validXConfResponse();
 
+    fscMetricsObserve(FSC_METRIC_XCONF_PARSE, fscMonotonicTime() - start);
+    if (bValidXconf)
+        fscBootPerfMarkXconf(fscRootPath(FSC_XCONF_RESPONSE_FILE, path, sizeof(path)));
+
+    // When components are required to report in, all of them need to be up as well. The same
+    // goes for the critical processes if they are required to be running, and for the WAN
+    // interface if we are watching one.
+    bValidXconf = bValidXconf && fscHeartbeatsComplete() && (!bRequireProcesses || fscProcAllRunning()) &&
+                  fscNetlinkWanReady();
+
     // Basically we have to check to see if we have a /tmp/response.txt file. If so, we were
     // able to get a response back from XConf.
     // Only do this check if we are a production image or the nvram debug flag is set.
@@ -204,11 +221,165 @@ BOOLEAN checkXconfValid()
     return FALSE;
 }
 
-static double TimeSpecToSeconds(struct timespec* ts)
+/*
+ * Probes which see the device moving forward report it here
+ */
+void fscNoteProgress(void)
 {
-    return (double)ts->tv_sec + (double)ts->tv_nsec / 1000000000.0;
+    bProgressNoted = TRUE;
 }
 
+/*
+ * Check to see if any of the progress markers appeared or changed, or progress was noted by one
+ * of the probes, since the last call.
+ */
+BOOLEAN checkProgress()
+{
+    char path[FSC_ROOT_PATH_LEN];
+    struct stat st;
+    BOOLEAN bProgress = bProgressNoted;
+    int i;
+
+    bProgressNoted = FALSE;
+
+    for (i = 0; progressMarkers[i] != NULL; i++) {
+        if (stat(fscRootPath(progressMarkers[i], path, sizeof(path)), &st) != 0)
+            continue;
+
+        if (st.st_mtime != progressMtime[i]) {
+            FSC_LOG(LOG_SEV_INFO, "Progress detected on %s \n", progressMarkers[i]);
+            progressMtime[i] = st.st_mtime;
+            bProgress = TRUE;
+        }
+    }
+
+    return bProgress;
+}
+
+
+/*
+ * Take the next sample right away
+ */
+void fscRequestRecheck(void)
+{
+    bRecheckRequested = TRUE;
+}
+
+/*
+ * Toggle the debug override at runtime, takes effect with the next sample
+ */
+void fscSetDebugOverride(BOOLEAN bOverride)
+{
+    fscStatus_t *status;
+
+    bDebugOverride = bOverride;
+    bRecheckRequested = TRUE;
+
+    status = fscStatusBeginUpdate();
+    if (bDebugOverride)
+        status->flags |= FSC_FLAG_DEBUG_OVERRIDE;
+    else
+        status->flags &= ~FSC_FLAG_DEBUG_OVERRIDE;
+    fscStatusEndUpdate();
+}
+
+/*
+ * Run the event loop until the next sample is due or a recheck is requested
+ */
+static void waitForNextSample(int interval)
+{
+    double wakeup = fscMonotonicTime() + interval;
+    double now;
+
+    while (!bRecheckRequested && (now = fscMonotonicTime()) < wakeup)
+        fscLoopRun((int)((wakeup - now) * 1000.0) + 1);
+
+    bRecheckRequested = FALSE;
+}
+
+/*
+ * Run the fatal signal probes, returns TRUE if the image is to be failed right away
+ */
+static BOOLEAN checkFatal(char *reason, size_t len)
+{
+    if (!bFastFail || !fscCheckFatalSignals(reason, len))
+        return FALSE;
+
+    FSC_LOG(LOG_SEV_INFO, "Fatal signal detected, failing image: %s \n", reason);
+    return TRUE;
+}
+
+/*
+ * Account for the time a sample took
+ */
+static void sampleDone(fscPolicy_t *policy, double seconds)
+{
+    fscMetricsObserve(FSC_METRIC_SAMPLE_TIME, seconds);
+    fscPolicySampleTime(policy, seconds);
+
+    if (seconds > policy->config->sampleInterval) {
+        fscMetricsAdd(FSC_METRIC_SAMPLE_OVERRUNS, 1);
+        FSC_LOG(LOG_SEV_WARN, "Sample took %.1f seconds, longer than the %d second interval\n", seconds, policy->config->sampleInterval);
+    }
+}
+
+/*
+ * The verdict has to reach the hal before its own timeout fires and it rolls the image back
+ */
+static void reportDeadline(const fscPolicy_t *policy, double verdictTime)
+{
+    if (verdictTime > policy->halDeadline) {
+        FSC_LOG(LOG_SEV_ERROR, "FSC_DEADLINE_MISSED verdict delivered at %.1f seconds, %.1f seconds past the hal deadline\n",
+                verdictTime, verdictTime - policy->halDeadline);
+    } else {
+        FSC_LOG(LOG_SEV_INFO, "Verdict delivered at %.1f seconds, %.1f seconds before the hal deadline, slowest sample %.3f seconds\n",
+                verdictTime, policy->halDeadline - verdictTime, policy->worstSample);
+    }
+}
+
+/*
+ * Publish the state of the check to the status page
+ */
+static void publishStatus(eFscPhase phase, double elapsedTime, double expiryTime, int halTimeout, uint32_t probes)
+{
+    fscStatus_t *status = fscStatusBeginUpdate();
+    int i;
+
+    status->phase = phase;
+    status->flags = (bIsProduction ? FSC_FLAG_PRODUCTION : 0) | (bDebugOverride ? FSC_FLAG_DEBUG_OVERRIDE : 0) |
+                    (bProgressMode ? FSC_FLAG_PROGRESSIVE : 0) | (bFastFail ? FSC_FLAG_FAST_FAIL : 0) |
+                    (fscGuardEnabled() ? FSC_FLAG_GUARD : 0);
+    status->elapsed = (uint32_t)elapsedTime;
+    status->remaining = (expiryTime > elapsedTime) ? (uint32_t)(expiryTime - elapsedTime) : 0;
+    status->halTimeout = (uint32_t)halTimeout;
+    status->probes = probes;
+    status->restarts = 0;
+    for (i = 0; i < fscProcCount(); i++)
+        status->restarts += (uint32_t)fscProcRestarts(i);
+    status->memoryStallMs = fscPsiStallMs(FSC_PSI_MEMORY);
+    status->cpuStallMs = fscPsiStallMs(FSC_PSI_CPU);
+    status->kernelOopses = fscKmsgCount(FSC_KMSG_OOPS) + fscKmsgCount(FSC_KMSG_PANIC);
+    status->oomKills = fscKmsgCount(FSC_KMSG_OOM);
+    status->xconfResult = (uint32_t)xconfResult;
+    if (phase == FSC_PHASE_CHECKING)
+        status->samples++;
+
+    fscStatusEndUpdate();
+}
+
+/*
+ * Publish the final verdict to the status page
+ */
+static void publishVerdict(BOOLEAN bValidImage, const char *reason)
+{
+    fscStatus_t *status = fscStatusBeginUpdate();
+
+    status->phase = FSC_PHASE_DONE;
+    status->verdict = bValidImage ? FSC_VERDICT_VALID : FSC_VERDICT_INVALID;
+    snprintf(status->reason, sizeof(status->reason), "%s", reason);
+
+    fscStatusEndUpdate();
+}
 
 /*
  * Main routine
@@ -216,9 +387,152 @@ static double TimeSpecToSeconds(struct timespec* ts)
 int main(int argc, char* argv[])
 {
     BOOLEAN bValidImage = FALSE;
+    BOOLEAN bFatal = FALSE;
+    BOOLEAN bPressure = FALSE;
+    BOOLEAN bChecking = FALSE;
+
+    double startTime;
+    double sampleStart;
+    double elapsedTime = 0;
+    fscPolicyConfig_t policyConfig;
+    fscPolicy_t policy;
+    uint32_t probes = 0;
+    const char *verdictReason = "not a production image";
+    int halTimeout;
+    char fatalReason[DATA_SIZE] = {0};
+    char perfReason[DATA_SIZE] = {0};
+    char expiredReason[DATA_SIZE] = {0};
+    int opt, i;
+
+    static const struct option longOptions[] = {
+        { "progressive",  no_argument, NULL, 'p' },
+        { "no-fast-fail", no_argument, NULL, 'n' },
+        { "hal",          required_argument, NULL, 'H' },
+        { "components",   required_argument, NULL, 'c' },
+        { "processes",    required_argument, NULL, 'P' },
+        { "require-processes", no_argument, NULL, 'r' },
+        { "wan-interface", required_argument, NULL, 'w' },
+        { "pressure",     no_argument, NULL, 'm' },
+        { "pressure-fail", no_argument, NULL, 'M' },
+        { "boot-threshold", required_argument, NULL, 'b' },
+        { "boot-fail",    no_argument, NULL, 'B' },
+        { "resource-interval", required_argument, NULL, 's' },
+        { "log-files",    required_argument, NULL, 'l' },
+        { "log-patterns", required_argument, NULL, 'L' },
+        { "log-fail",     no_argument, NULL, 'F' },
+        { "xconf-sentinels", required_argument, NULL, 'x' },
+        { "replay",       required_argument, NULL, 'R' },
+        { "root",         required_argument, NULL, 'C' },
+        { "guard",        no_argument, NULL, 'g' },
+        { "sched",        required_argument, NULL, 'S' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    // The hal backend can also be picked from the environment, e.g. FSC_HAL_BACKEND=stub
+    fscHalSetBackend(getenv("FSC_HAL_BACKEND"));
+
+    // So can the root directory of all the files we use, e.g. FSC_ROOT=/tmp/fsc.1
+    if (fscRootSet(getenv(FSC_ROOT_ENV)) != 0) {
+        fprintf(stderr, "%s is longer than %d characters\n", FSC_ROOT_ENV, FSC_ROOT_MAX_LEN);
+        return 1;
+    }
 
-    struct timespec t1, t2;
-    double elapsedTime;
+    while ((opt = getopt_long(argc, argv, "pnH:c:P:rw:mMb:Bs:l:L:Fx:R:C:gS:", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'p':
+            bProgressMode = TRUE;
+            break;
+        case 'n':
+            bFastFail = FALSE;
+            break;
+        case 'H':
+            fscHalSetBackend(optarg);
+            break;
+        case 'c':
+            if (fscHeartbeatSetRequired(optarg) != 0)
+                return 1;
+            break;
+        case 'P':
+            if (fscProcSetProcesses(optarg) != 0)
+                return 1;
+            break;
+        case 'r':
+            bRequireProcesses = TRUE;
+            break;
+        case 'w':
+            fscNetlinkSetInterface(optarg);
+            break;
+        case 'm':
+            fscPsiEnable(FALSE);
+            break;
+        case 'M':
+            fscPsiEnable(TRUE);
+            break;
+        case 'b':
+            if (fscBootPerfSetThreshold(optarg) != 0)
+                return 1;
+            break;
+        case 'B':
+            bBootPerfFail = TRUE;
+            break;
+        case 's':
+            if (fscProfileSetInterval(optarg) != 0)
+                return 1;
+            break;
+        case 'l':
+            if (fscLogWatchSetFiles(optarg) != 0)
+                return 1;
+            break;
+        case 'L':
+            if (fscLogWatchSetPatterns(optarg) != 0)
+                return 1;
+            break;
+        case 'F':
+            fscLogWatchSetFail(TRUE);
+            break;
+        case 'x':
+            if (fscXconfSetSentinels(optarg) != 0)
+                return 1;
+            break;
+        case 'R':
+            if (fscReplaySetTrace(optarg) != 0)
+                return 1;
+            break;
+        case 'C':
+            if (fscRootSet(optarg) != 0) {
+                fprintf(stderr, "Root directory %s is longer than %d characters\n", optarg, FSC_ROOT_MAX_LEN);
+                return 1;
+            }
+            break;
+        case 'g':
+            fscGuardEnable();
+            break;
+        case 'S':
+            if (fscGuardSetScheduler(optarg) != 0)
+                return 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p|--progressive] [-n|--no-fast-fail] [-H|--hal <library>|stub]\n"
+                            "       [-c|--components <name,...>] [-P|--processes <name,...>] [-r|--require-processes]\n"
+                            "       [-w|--wan-interface <ifname>] [-m|--pressure] [-M|--pressure-fail]\n"
+                            "       [-b|--boot-threshold <percent>] [-B|--boot-fail]\n"
+                            "       [-s|--resource-interval <seconds>] [-l|--log-files <name,...>]\n"
+                            "       [-L|--log-patterns <file>] [-F|--log-fail] [-x|--xconf-sentinels <file>]\n"
+                            "       [-R|--replay <trace>] [-C|--root <dir>] [-g|--guard] [-S|--sched fifo|rr]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // A replay runs on the virtual clock and must never touch the image banks, nor the files of a
+    // real fscMonitor
+    if (fscReplayActive()) {
+        if (fscRootDir()[0] == 0) {
+            fprintf(stderr, "A replay needs a private --root directory\n");
+            return 1;
+        }
+        fscClockSetVirtual();
+        fscHalSetBackend("stub");
+    }
 
 #ifdef FEATURE_SUPPORT_RDKLOG
     pComponentName = compName;
@@ -227,9 +541,24 @@ int main(int argc, char* argv[])
 
     FSC_LOG(LOG_SEV_INFO, "Started power manager\n");
 
+    // Before the hal thread is started, so its stack is locked as well
+    fscGuardInit();
+    fscHalInit();
+    fscStatusInit();
+    fscLoopInit();
+
+    // Tell the hal what the image validation expiry time is. In progress-aware mode we start short
+    // and only keep extending while the device is visibly coming up.
+    fscPolicyDefaults(&policyConfig);
+    policyConfig.bProgressive = bProgressMode;
+    fscPolicyInit(&policy, &policyConfig);
+    if (bProgressMode) {
+        FSC_LOG(LOG_SEV_INFO, "Progress-aware mode, initial timeout %d seconds\n", policy.halTimeout);
+    }
+    fscHalSetImageTimeout(policy.halTimeout);
 
-    // Tell the hal what the image validation expiry time is.
-    platform_hal_SetDeviceCodeImageTimeout(FSC_TIMEOUT_VALUE);
+    // The hal timeout runs from here, and so do the policy times
+    startTime = fscMonotonicTime();
 
     // Check to see if we have our debug override file in place
     if ((bDebugOverride = doesFileExist(FSC_DEBUG_FILE))) {
@@ -242,38 +571,142 @@ int main(int argc, char* argv[])
     if (!bDebugOverride && !bIsProduction) {
         bValidImage = TRUE;
     } else {
-        // get start time
-        clock_gettime(CLOCK_MONOTONIC, &t1);
+        bChecking = TRUE;
         FSC_LOG(LOG_SEV_INFO, "Starting Firmware Sanity Checker Process...\n");
+
+        fscBootPerfInit();
+        fscProcInit();
+        if (bFastFail)
+            fscProbesInit();
+
+        fscCtlInit();
+        fscMetricsInit();
+        fscHeartbeatInit();
+        fscNetlinkInit();
+        fscPsiInit();
+        fscProfileInit();
+        fscKmsgInit();
+        fscLogWatchInit();
     }
+    fscReplayInit();
+    fscGuardPrefault();
+    publishStatus(bValidImage ? FSC_PHASE_DONE : FSC_PHASE_CHECKING, 0, policy.expiryTime, policy.halTimeout, 0);
 
-    while(!bValidImage)
+    // Boot loops and the like are caught before the first sample
+    bFatal = !bValidImage && checkFatal(fatalReason, sizeof(fatalReason));
+
+    while(!bValidImage && !bFatal)
     {
-        sleep(sampleInterval);
+        waitForNextSample(policyConfig.sampleInterval);
+        sampleStart = fscMonotonicTime();
+        fscMetricsAdd(FSC_METRIC_POLLS, 1);
+        fscProcRefresh();
+        bPressure = fscPsiSample();
 
-        // get our current delta time
-        clock_gettime(CLOCK_MONOTONIC, &t2);
         // compute the elapsed time in seconds
-        elapsedTime = TimeSpecToSeconds(&t2) - TimeSpecToSeconds(&t1);
+        elapsedTime = fscMonotonicTime() - startTime;
+
+        // Definitive failure signals end the check early with an invalid verdict
+        if ((bFatal = checkFatal(fatalReason, sizeof(fatalReason))))
+            break;
 
         // FSC_LOG(LOG_SEV_INFO, "Test for valid XConf response at %f seconds \n", elapsedTime);
 
         // Check to see if we have a valid xconf connection.
+        probes = 0;
         if (!(bValidImage = checkXconfValid()))
         {
-            if (elapsedTime >= (double) (FSC_TIMEOUT_VALUE - timeOffset)) // adjust expiry time by 5 minutes
+            if (bProgressMode && checkProgress())
+            {
+                probes |= FSC_PROBE_PROGRESS;
+
+                if ((halTimeout = fscPolicyProgress(&policy, elapsedTime)) > 0)
+                {
+                    FSC_LOG(LOG_SEV_INFO, "Progress detected, re-arming hal timeout to %d seconds at %.0f seconds\n", halTimeout, elapsedTime);
+                    fscHalSetImageTimeout(halTimeout);
+                }
+            }
+
+            if (fscPolicyExpired(&policy, elapsedTime))
             {
+                if (elapsedTime < policy.expiryTime)
+                    FSC_LOG(LOG_SEV_WARN, "Samples take up to %.1f seconds, giving up early to meet the hal deadline\n", policy.worstSample);
                 FSC_LOG(LOG_SEV_INFO, "Time expired waiting for valid xconf connection \n");
                 // If we got here our time is expired without getting an xconf connection - fall out and fail
+                snprintf(expiredReason, sizeof(expiredReason), "time expired waiting for valid xconf connection (last response %s)",
+                         fscXconfResultName(xconfResult));
+                verdictReason = expiredReason;
                 break;
             }
         }
+        else
+        {
+            probes |= FSC_PROBE_XCONF_VALID;
+            verdictReason = "valid xconf response";
+        }
+
+        if (fscHeartbeatsComplete())
+            probes |= FSC_PROBE_COMPONENTS;
+        if (fscProcAllRunning()) {
+            probes |= FSC_PROBE_PROCESSES;
+            fscBootPerfMarkProcesses();
+        }
+        if (fscNetlinkEnabled() && fscNetlinkWanReady())
+            probes |= FSC_PROBE_WAN_READY;
+        if (bPressure)
+            probes |= FSC_PROBE_PRESSURE;
+
+        // Stalled flash or a blocking probe slows the samples down, which eats into the time left
+        // before the hal deadline
+        sampleDone(&policy, fscMonotonicTime() - sampleStart);
+
+        publishStatus(FSC_PHASE_CHECKING, elapsedTime, policy.expiryTime, policy.halTimeout, probes);
+    }
+
+    if (bFatal)
+    {
+        verdictReason = fatalReason;
+        publishStatus(FSC_PHASE_CHECKING, elapsedTime, policy.expiryTime, policy.halTimeout, probes | FSC_PROBE_FATAL);
+    }
+
+    // A new image which boots slower or leaves less memory than the last good one regressed
+    if (bChecking && fscBootPerfVerdict(bValidImage, bBootPerfFail, perfReason, sizeof(perfReason)))
+    {
+        probes |= FSC_PROBE_BOOT_REGRESSION;
+        if (bValidImage && bBootPerfFail)
+        {
+            bValidImage = FALSE;
+            verdictReason = perfReason;
+        }
+        publishStatus(FSC_PHASE_CHECKING, elapsedTime, policy.expiryTime, policy.halTimeout, probes);
     }
 
+    fscCtlShutdown();
+    fscMetricsShutdown();
+    fscHeartbeatShutdown();
+    fscLogWatchShutdown();
+
     // call the platform hal to tell them if this image is valid or not.
-    platform_hal_SetDeviceCodeImageValid(bValidImage);
+    if (fscHalSetImageValid(bValidImage) != RETURN_OK) {
+        FSC_LOG(LOG_SEV_ERROR, "Failed to deliver image verdict to the hal\n");
+    }
+    if (bChecking)
+        reportDeadline(&policy, fscMonotonicTime() - startTime);
+    fscProbesVerdict(bValidImage);
+    publishVerdict(bValidImage, verdictReason);
+    fscProfileStore(bValidImage);
+
+    fscPsiReport(elapsedTime);
+    fscKmsgReport();
+    fscLogWatchReport();
+    for (i = 0; i < fscProcCount(); i++) {
+        if (fscProcRestarts(i) > 0)
+            FSC_LOG(LOG_SEV_INFO, "%s restarted %d times during the check\n", fscProcName(i), fscProcRestarts(i));
+    }
+
+    fscGuardReport();
 
     FSC_LOG(LOG_SEV_INFO, "Firmware Sanity Checker Exit with valid image: %s\n", (bValidImage?"true":"false"));
 
-    return 0;
+    return fscReplayActive() ? fscReplayVerdict(bValidImage) : 0;
 }
@@ -0,0 +1,341 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscMonitor.h
+ * @brief Firmware Sanity Checker common definitions
+ */
+
+#ifndef FSC_MONITOR_H
+#define FSC_MONITOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+typedef enum {
+    LOG_SEV_ERROR,
+    LOG_SEV_WARN,
+    LOG_SEV_INFO
+} eLogSeverity;
+
+#ifdef FEATURE_SUPPORT_RDKLOG
+#include "ccsp_trace.h"
+#define FSC_LOG(x, ...) { if((x)==(LOG_SEV_INFO)){CcspTraceInfo((__VA_ARGS__));}else if((x)==(LOG_SEV_WARN)){CcspTraceWarning((__VA_ARGS__));}else if((x)==(LOG_SEV_ERROR)){CcspTraceError((__VA_ARGS__));} }
+#else
+// Log macros
+#define FSC_LOG(x, fmt, args...) \
+    { \
+        struct tm *gtime; time_t now; \
+        char buf[80]; \
+        time(&now); gtime = gmtime(&now); \
+        strftime(buf,80,"%y%m%d-%H:%M:%S",gtime); \
+        fprintf(stderr, "%s [FSC_LOG] %s(), " fmt, \
+                buf,__FUNCTION__,##args); fflush(stderr); \
+    }
+#endif
+
+// We need to put this after the ccsp_trace.h above, since it re-defines CHAR
+#include "platform_hal.h"
+
+#include "fscStatus.h"
+#include "fscRoot.h"
+
+/*
+ * fscMonitor.c
+ */
+BOOLEAN doesFileExist(const char *filename);
+BOOLEAN fscGetImageName(char *name, size_t len);
+void fscRequestRecheck(void);
+void fscNoteProgress(void);
+void fscSetDebugOverride(BOOLEAN bOverride);
+
+/*
+ * fscClock.c - real or virtual time source
+ */
+void fscClockSetVirtual(void);
+BOOLEAN fscClockIsVirtual(void);
+double fscMonotonicTime(void);
+double fscClockUptime(void);
+time_t fscClockWallTime(void);
+void fscClockSleep(double seconds);
+int fscClockBlockMs(int timeoutMs);
+void fscClockIdle(int timeoutMs);
+
+/*
+ * fscPolicy.c - timeout policy of the check, shared with the fleet simulator
+ */
+typedef struct {
+    int sampleInterval;         // seconds between samples
+    int timeOffset;             // the check gives up this long before the hal times out
+    int maxTimeout;             // hal timeout, never exceeded in total
+    BOOLEAN bProgressive;       // start short and extend while the device makes progress
+    int initialTimeout;         // hal timeout armed first in progress-aware mode
+    int extendValue;            // expiry is moved out to this long after the last progress
+    int verdictReserve;         // time left for delivering the verdict before the hal times out
+} fscPolicyConfig_t;
+
+typedef struct {
+    const fscPolicyConfig_t *config;
+    int halTimeout;
+    double expiryTime;          // seconds since the hal was first armed
+    double halDeadline;         // when the hal timeout fires, on the same scale
+    double worstSample;         // longest a sample took so far
+} fscPolicy_t;
+
+void fscPolicyDefaults(fscPolicyConfig_t *config);
+void fscPolicyInit(fscPolicy_t *policy, const fscPolicyConfig_t *config);
+int fscPolicyProgress(fscPolicy_t *policy, double elapsedTime);
+void fscPolicySampleTime(fscPolicy_t *policy, double seconds);
+BOOLEAN fscPolicyExpired(const fscPolicy_t *policy, double elapsedTime);
+
+/*
+ * fscProbes.c - fatal signal probes which can end the check early with an invalid verdict
+ */
+void fscProbesInit(void);
+BOOLEAN fscCheckFatalSignals(char *reason, size_t len);
+void fscProbesVerdict(BOOLEAN bValidImage);
+
+/*
+ * fscBootRecord.c - crash-safe boot attempt ring kept in /nvram
+ */
+void fscBootRecordInit(void);
+BOOLEAN fscBootRecordIsLooping(char *reason, size_t len);
+void fscBootRecordVerdict(BOOLEAN bValidImage);
+
+/*
+ * fscHal.c - asynchronous platform hal dispatch
+ */
+void fscHalSetBackend(const char *backend);
+void fscHalInit(void);
+INT fscHalSetImageTimeout(INT seconds);
+INT fscHalSetImageValid(BOOLEAN flag);
+
+/*
+ * fscGuard.c - deadline-guarantee mode
+ */
+void fscGuardEnable(void);
+int fscGuardSetScheduler(const char *policy);
+BOOLEAN fscGuardEnabled(void);
+void fscGuardThreadInit(void);
+void fscGuardInit(void);
+void fscGuardPrefault(void);
+void fscGuardReport(void);
+
+/*
+ * fscHalStub.c - in-tree stub hal backend
+ */
+INT fscHalStubSetImageTimeout(INT seconds);
+INT fscHalStubSetImageValid(BOOLEAN flag);
+void fscHalStubConfigure(int delayMs, int failures);
+
+/*
+ * fscStatus.c - shared memory status page writer
+ */
+void fscStatusInit(void);
+fscStatus_t *fscStatusBeginUpdate(void);
+void fscStatusEndUpdate(void);
+const fscStatus_t *fscStatusCurrent(void);
+
+/*
+ * fscLoop.c - epoll based main event loop
+ */
+typedef void (*fscLoopHandler_t)(int fd, uint32_t events, void *ctx);
+typedef void (*fscLoopTimerHandler_t)(void *ctx);
+
+void fscLoopInit(void);
+int fscLoopAdd(int fd, uint32_t events, fscLoopHandler_t handler, void *ctx);
+void fscLoopRemove(int fd);
+int fscLoopTimerAdd(fscLoopTimerHandler_t handler, void *ctx);
+void fscLoopTimerArm(int timer, double delay, double interval);
+void fscLoopTimerDisarm(int timer);
+void fscLoopTimerRemove(int timer);
+void fscLoopRun(int timeoutMs);
+
+/*
+ * fscCtl.c - control socket server
+ */
+void fscCtlInit(void);
+void fscCtlShutdown(void);
+
+/*
+ * fscMetrics.c - metrics registry and Prometheus text endpoint
+ */
+typedef enum {
+    FSC_METRIC_POLLS,
+    FSC_METRIC_WAKEUPS,
+    FSC_METRIC_BYTES_READ,
+    FSC_METRIC_HAL_CALLS,
+    FSC_METRIC_HAL_ERRORS,
+    FSC_METRIC_KMSG_RECORDS,
+    FSC_METRIC_KMSG_DROPPED,
+    FSC_METRIC_LOG_BYTES,
+    FSC_METRIC_LOG_MATCHES,
+    FSC_METRIC_SAMPLE_OVERRUNS,
+    FSC_METRIC_NUM_COUNTERS
+} eFscCounter;
+
+typedef enum {
+    FSC_METRIC_XCONF_PARSE,
+    FSC_METRIC_HAL_LATENCY,
+    FSC_METRIC_SAMPLE_TIME,
+    FSC_METRIC_NUM_HISTOGRAMS
+} eFscHistogram;
+
+void fscMetricsInit(void);
+void fscMetricsShutdown(void);
+void fscMetricsAdd(eFscCounter counter, uint64_t value);
+void fscMetricsObserve(eFscHistogram histogram, double seconds);
+
+/*
+ * fscHeartbeat.c - component heartbeat receiver
+ */
+int fscHeartbeatSetRequired(const char *list);
+BOOLEAN fscHeartbeatsComplete(void);
+void fscHeartbeatInit(void);
+void fscHeartbeatShutdown(void);
+int fscHeartbeatInject(const char *name);
+
+/*
+ * fscProc.c - critical process presence probe
+ */
+#define FSC_PROC_MAX_PROCESSES 16
+
+int fscProcSetProcesses(const char *list);
+void fscProcInit(void);
+void fscProcRefresh(void);
+int fscProcCount(void);
+const char *fscProcName(int idx);
+pid_t fscProcPid(int idx);
+int fscProcRestarts(int idx);
+int fscProcRestartsInWindow(int idx, double window);
+BOOLEAN fscProcAllRunning(void);
+int fscProcInject(const char *name, BOOLEAN bRunning);
+
+/*
+ * fscNetlink.c - WAN readiness probe
+ */
+void fscNetlinkSetInterface(const char *ifname);
+void fscNetlinkInit(void);
+BOOLEAN fscNetlinkEnabled(void);
+BOOLEAN fscNetlinkWanReady(void);
+
+/*
+ * fscPsi.c - memory and CPU pressure probe
+ */
+#define FSC_PSI_MEMORY 0
+#define FSC_PSI_CPU 1
+
+void fscPsiEnable(BOOLEAN bFail);
+void fscPsiInit(void);
+BOOLEAN fscPsiSample(void);
+BOOLEAN fscPsiCheckFatal(char *reason, size_t len);
+uint32_t fscPsiStallMs(int resource);
+void fscPsiReport(double elapsedTime);
+
+/*
+ * fscBootPerf.c - boot milestones compared against the last validated image
+ */
+int fscBootPerfSetThreshold(const char *percent);
+void fscBootPerfInit(void);
+void fscBootPerfMarkXconf(const char *responseFile);
+void fscBootPerfMarkProcesses(void);
+uint32_t fscBootPerfProcessStartMs(pid_t pid);
+BOOLEAN fscBootPerfVerdict(BOOLEAN bValid, BOOLEAN bFail, char *reason, size_t len);
+
+/*
+ * fscProfile.c - resource sampler, stored compressed in /nvram at the verdict
+ */
+int fscProfileSetInterval(const char *seconds);
+void fscProfileInit(void);
+void fscProfileShutdown(void);
+void fscProfileStore(BOOLEAN bValid);
+
+/*
+ * fscMatch.c - single pass multi-pattern matcher
+ */
+#define FSC_MATCH_MAX_PATTERNS 32
+#define FSC_MATCH_NOCASE (1 << 0)
+
+typedef struct fscMatcher fscMatcher_t;
+typedef int (*fscMatchHandler_t)(int pattern, size_t end, void *ctx);
+
+fscMatcher_t *fscMatchCompile(const char *const *patterns, int count, int flags);
+void fscMatchFree(fscMatcher_t *m);
+size_t fscMatchPatternLength(const fscMatcher_t *m, int pattern);
+uint32_t fscMatchScan(const fscMatcher_t *m, uint32_t *state, const char *buf, size_t len,
+                      fscMatchHandler_t handler, void *ctx);
+
+/*
+ * fscKmsg.c - kernel log watcher
+ */
+#define FSC_KMSG_OOPS 0
+#define FSC_KMSG_PANIC 1
+#define FSC_KMSG_OOM 2
+#define FSC_KMSG_LOCKUP 3
+#define FSC_KMSG_WARNING 4
+#define FSC_KMSG_NUM_CLASSES 5
+
+void fscKmsgInit(void);
+uint32_t fscKmsgCount(int class);
+BOOLEAN fscKmsgCheckFatal(char *reason, size_t len);
+void fscKmsgReport(void);
+void fscKmsgInject(const char *message);
+
+/*
+ * fscLogWatch.c - log file follower matching known fatal strings
+ */
+int fscLogWatchSetFiles(const char *list);
+int fscLogWatchSetPatterns(const char *file);
+void fscLogWatchSetFail(BOOLEAN bFail);
+void fscLogWatchInit(void);
+void fscLogWatchShutdown(void);
+BOOLEAN fscLogWatchCheckFatal(char *reason, size_t len);
+void fscLogWatchReport(void);
+
+/*
+ * fscXconf.c - single pass xconf response classifier
+ */
+typedef struct {
+    uint32_t state;             // matcher state
+    uint32_t seen;              // patterns seen
+    int valueState;             // parsing the firmwareFilename value
+    char firmware[128];
+    size_t firmwareLen;
+    size_t total;               // bytes fed
+    char first;                 // first and last non-blank bytes, to tell an unfinished document
+    char last;
+} fscXconfParser_t;
+
+int fscXconfSetSentinels(const char *file);
+void fscXconfParserInit(fscXconfParser_t *p);
+void fscXconfParserFeed(fscXconfParser_t *p, const char *buf, size_t len);
+eFscXconfResult fscXconfParserResult(fscXconfParser_t *p);
+eFscXconfResult fscXconfClassifyFile(const char *path, char *firmware, size_t len);
+const char *fscXconfResultName(eFscXconfResult result);
+
+/*
+ * fscReplay.c - replay of a recorded event trace on the virtual clock
+ */
+int fscReplaySetTrace(const char *file);
+BOOLEAN fscReplayActive(void);
+void fscReplayInit(void);
+int fscReplayVerdict(BOOLEAN bValidImage);
+
+#endif /* FSC_MONITOR_H */
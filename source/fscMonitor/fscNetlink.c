@@ -0,0 +1,432 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscNetlink.c
+ * @brief WAN readiness probe
+ *
+ * Observes the WAN interface directly instead of inferring it from the xconf response. We subscribe
+ * to rtnetlink link, address and route notifications and keep an incremental view of the WAN
+ * interface: carrier, its addresses and the default routes of the main table which go through it,
+ * directly or as one of the next hops of a multipath route. Routes are tracked one by one, so the
+ * removal of one default route leaves the others counted. The view is seeded with a dump of each
+ * kind when the socket is opened, and dumped again should the socket ever overflow.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "fscMonitor.h"
+
+#define FSC_WAN_MAX_ADDRS 8
+#define FSC_WAN_MAX_ROUTES 8
+#define FSC_WAN_ROUTE_TABLE RT_TABLE_MAIN
+#define FSC_NETLINK_BUFFER_SIZE 32768
+
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+typedef enum {
+    DUMP_LINKS,
+    DUMP_ADDRS,
+    DUMP_ROUTES,
+    DUMP_DONE
+} eDumpStage;
+
+typedef struct {
+    unsigned char family;
+    unsigned char len;
+    unsigned char addr[16];
+} fscWanAddr_t;
+
+// What the kernel tells default routes of a table apart by, the gateway only for IPv6
+typedef struct {
+    unsigned char family;
+    unsigned char tos;
+    uint32_t priority;
+    unsigned char gateway[16];
+} fscWanRoute_t;
+
+static const char *wanInterface = NULL;
+static int netlinkFd = -1;
+static uint32_t netlinkSeq = 0;
+static eDumpStage dumpStage = DUMP_DONE;
+
+static int wanIfindex = 0;
+static BOOLEAN bWanCarrier = FALSE;
+static fscWanAddr_t wanAddrs[FSC_WAN_MAX_ADDRS];
+static int numWanAddrs = 0;
+static fscWanRoute_t wanRoutes[FSC_WAN_MAX_ROUTES];
+static int numWanRoutes = 0;
+static BOOLEAN bWanReady = FALSE;
+
+static char netlinkBuffer[FSC_NETLINK_BUFFER_SIZE] __attribute__((aligned(4)));
+
+static void sendDump(int type)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct rtgenmsg gen;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(req.gen));
+    req.nlh.nlmsg_type = (uint16_t)type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++netlinkSeq;
+    req.gen.rtgen_family = AF_UNSPEC;
+
+    if (send(netlinkFd, &req, req.nlh.nlmsg_len, 0) < 0)
+        FSC_LOG(LOG_SEV_ERROR, "Error sending netlink dump request: %s\n", strerror(errno));
+}
+
+/*
+ * Start over with a fresh view, the dumps are run one after the other
+ */
+static void resync(void)
+{
+    wanIfindex = 0;
+    bWanCarrier = FALSE;
+    numWanAddrs = 0;
+    numWanRoutes = 0;
+
+    dumpStage = DUMP_LINKS;
+    sendDump(RTM_GETLINK);
+}
+
+static void nextDump(void)
+{
+    if (dumpStage == DUMP_LINKS) {
+        dumpStage = DUMP_ADDRS;
+        sendDump(RTM_GETADDR);
+    } else if (dumpStage == DUMP_ADDRS) {
+        dumpStage = DUMP_ROUTES;
+        sendDump(RTM_GETROUTE);
+    } else {
+        dumpStage = DUMP_DONE;
+    }
+}
+
+static void handleLink(struct nlmsghdr *nlh)
+{
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    int len = (int)IFLA_PAYLOAD(nlh);
+    struct rtattr *rta;
+    const char *name = NULL;
+
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME)
+            name = (const char *)RTA_DATA(rta);
+    }
+
+    if (nlh->nlmsg_type == RTM_DELLINK || name == NULL || strcmp(name, wanInterface) != 0) {
+        // Our interface went away or was renamed
+        if (ifi->ifi_index == wanIfindex) {
+            wanIfindex = 0;
+            bWanCarrier = FALSE;
+            numWanAddrs = 0;
+            numWanRoutes = 0;
+        }
+        return;
+    }
+
+    if (wanIfindex != ifi->ifi_index) {
+        wanIfindex = ifi->ifi_index;
+        FSC_LOG(LOG_SEV_INFO, "WAN interface %s has index %d\n", wanInterface, wanIfindex);
+
+        // Addresses and routes of an interface which appeared later on were ignored so far
+        if (dumpStage == DUMP_DONE) {
+            resync();
+            return;
+        }
+    }
+
+    bWanCarrier = (ifi->ifi_flags & IFF_UP) && (ifi->ifi_flags & IFF_LOWER_UP);
+}
+
+static void handleAddr(struct nlmsghdr *nlh)
+{
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+    int len = (int)IFA_PAYLOAD(nlh);
+    struct rtattr *rta;
+    fscWanAddr_t addr;
+    int i;
+
+    if (wanIfindex == 0 || (int)ifa->ifa_index != wanIfindex)
+        return;
+
+    // Link local IPv6 addresses do not get us anywhere
+    if (ifa->ifa_family == AF_INET6 && ifa->ifa_scope != RT_SCOPE_UNIVERSE)
+        return;
+
+    memset(&addr, 0, sizeof(addr));
+    for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if ((rta->rta_type == IFA_LOCAL || (rta->rta_type == IFA_ADDRESS && addr.len == 0)) &&
+            RTA_PAYLOAD(rta) <= sizeof(addr.addr)) {
+            addr.family = ifa->ifa_family;
+            addr.len = (unsigned char)RTA_PAYLOAD(rta);
+            memcpy(addr.addr, RTA_DATA(rta), addr.len);
+        }
+    }
+    if (addr.len == 0)
+        return;
+
+    for (i = 0; i < numWanAddrs; i++) {
+        if (wanAddrs[i].family == addr.family && wanAddrs[i].len == addr.len &&
+            memcmp(wanAddrs[i].addr, addr.addr, addr.len) == 0) {
+            break;
+        }
+    }
+
+    if (nlh->nlmsg_type == RTM_NEWADDR) {
+        if (i == numWanAddrs && numWanAddrs < FSC_WAN_MAX_ADDRS)
+            wanAddrs[numWanAddrs++] = addr;
+    } else if (i < numWanAddrs) {
+        wanAddrs[i] = wanAddrs[--numWanAddrs];
+    }
+}
+
+/*
+ * Check to see if one of the next hops of a multipath route goes through the WAN interface
+ */
+static BOOLEAN multipathViaWan(struct rtattr *rta)
+{
+    struct rtnexthop *rtnh = (struct rtnexthop *)RTA_DATA(rta);
+    int len = (int)RTA_PAYLOAD(rta);
+
+    while (len >= (int)sizeof(*rtnh) && rtnh->rtnh_len >= sizeof(*rtnh) && rtnh->rtnh_len <= len) {
+        if (rtnh->rtnh_ifindex == wanIfindex)
+            return TRUE;
+        len -= RTNH_ALIGN(rtnh->rtnh_len);
+        rtnh = RTNH_NEXT(rtnh);
+    }
+
+    return FALSE;
+}
+
+static void handleRoute(struct nlmsghdr *nlh)
+{
+    struct rtmsg *rtm = (struct rtmsg *)NLMSG_DATA(nlh);
+    int len = (int)RTM_PAYLOAD(nlh);
+    struct rtattr *rta;
+    uint32_t table = rtm->rtm_table;
+    fscWanRoute_t route;
+    BOOLEAN bViaWan = FALSE;
+    int oif = 0;
+    int i;
+
+    if (wanIfindex == 0 || rtm->rtm_dst_len != 0 || rtm->rtm_type != RTN_UNICAST ||
+        (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)) {
+        return;
+    }
+
+    memset(&route, 0, sizeof(route));
+    route.family = rtm->rtm_family;
+    route.tos = rtm->rtm_tos;
+    for (rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == RTA_OIF && RTA_PAYLOAD(rta) >= sizeof(int)) {
+            memcpy(&oif, RTA_DATA(rta), sizeof(int));
+            bViaWan = (oif == wanIfindex);
+        } else if (rta->rta_type == RTA_MULTIPATH) {
+            bViaWan = multipathViaWan(rta);
+        } else if (rta->rta_type == RTA_TABLE && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+            // Tables above 255 only show up here
+            memcpy(&table, RTA_DATA(rta), sizeof(uint32_t));
+        } else if (rta->rta_type == RTA_PRIORITY && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+            memcpy(&route.priority, RTA_DATA(rta), sizeof(uint32_t));
+        } else if (rta->rta_type == RTA_GATEWAY && route.family == AF_INET6 && RTA_PAYLOAD(rta) <= sizeof(route.gateway)) {
+            memcpy(route.gateway, RTA_DATA(rta), RTA_PAYLOAD(rta));
+        }
+    }
+
+    // Policy routing tables are not where the device's own traffic goes
+    if (table != FSC_WAN_ROUTE_TABLE)
+        return;
+
+    for (i = 0; i < numWanRoutes; i++) {
+        if (memcmp(&wanRoutes[i], &route, sizeof(route)) == 0)
+            break;
+    }
+
+    // A route replaced by one through another interface is gone as far as we are concerned
+    if (nlh->nlmsg_type == RTM_NEWROUTE && bViaWan) {
+        if (i == numWanRoutes && numWanRoutes < FSC_WAN_MAX_ROUTES)
+            wanRoutes[numWanRoutes++] = route;
+    } else if (i < numWanRoutes) {
+        wanRoutes[i] = wanRoutes[--numWanRoutes];
+    }
+}
+
+/*
+ * Number of default routes of a family through the WAN interface
+ */
+static int wanDefaultRoutes(unsigned char family)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < numWanRoutes; i++) {
+        if (wanRoutes[i].family == family)
+            count++;
+    }
+
+    return count;
+}
+
+/*
+ * Re-evaluate readiness after a batch of messages
+ */
+static void updateReady(void)
+{
+    static int lastStage = 0;
+    BOOLEAN bReady = bWanCarrier && numWanAddrs > 0 && numWanRoutes > 0;
+    int stage = bWanCarrier + (numWanAddrs > 0) + (numWanRoutes > 0);
+
+    // Every step towards a usable WAN counts as progress
+    if (stage > lastStage)
+        fscNoteProgress();
+    lastStage = stage;
+
+    if (bReady == bWanReady)
+        return;
+
+    bWanReady = bReady;
+    FSC_LOG(LOG_SEV_INFO, "WAN interface %s is %s (carrier %d, %d addresses, default routes v4 %d v6 %d)\n",
+            wanInterface, bWanReady ? "ready" : "not ready", bWanCarrier, numWanAddrs,
+            wanDefaultRoutes(AF_INET), wanDefaultRoutes(AF_INET6));
+
+    // WAN coming up is worth a sample straight away
+    if (bWanReady)
+        fscRequestRecheck();
+}
+
+static void netlinkHandle(int fd, uint32_t events, void *ctx)
+{
+    struct nlmsghdr *nlh;
+    ssize_t len;
+
+    (void)events;
+    (void)ctx;
+
+    for (;;) {
+        len = recv(fd, netlinkBuffer, sizeof(netlinkBuffer), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // We lost notifications, the only way to catch up is to dump everything again
+                FSC_LOG(LOG_SEV_WARN, "Netlink socket overflowed, resynchronizing\n");
+                resync();
+                continue;
+            }
+            break;
+        }
+
+        for (nlh = (struct nlmsghdr *)netlinkBuffer; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            switch (nlh->nlmsg_type) {
+            case NLMSG_DONE:
+            case NLMSG_ERROR:
+                if (dumpStage != DUMP_DONE && nlh->nlmsg_seq == netlinkSeq)
+                    nextDump();
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                handleLink(nlh);
+                break;
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                handleAddr(nlh);
+                break;
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                handleRoute(nlh);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    updateReady();
+}
+
+/*
+ * Set the WAN interface to watch, the probe stays disabled without one
+ */
+void fscNetlinkSetInterface(const char *ifname)
+{
+    wanInterface = ifname;
+}
+
+/*
+ * Check to see if the probe is watching a WAN interface
+ */
+BOOLEAN fscNetlinkEnabled(void)
+{
+    return wanInterface != NULL && netlinkFd >= 0;
+}
+
+/*
+ * Check to see if the WAN interface has carrier, an address and a default route. Always TRUE if
+ * no WAN interface is watched.
+ */
+BOOLEAN fscNetlinkWanReady(void)
+{
+    return !fscNetlinkEnabled() || bWanReady;
+}
+
+/*
+ * Open the netlink socket, subscribe to notifications and start the initial dumps
+ */
+void fscNetlinkInit(void)
+{
+    struct sockaddr_nl addr;
+    int rcvbuf = 256 * 1024;
+
+    if (wanInterface == NULL)
+        return;
+
+    if ((netlinkFd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating netlink socket: %s\n", strerror(errno));
+        return;
+    }
+
+    // Notifications come in bursts during boot, give them some room
+    setsockopt(netlinkFd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+
+    if (bind(netlinkFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        fscLoopAdd(netlinkFd, EPOLLIN, netlinkHandle, NULL) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error setting up netlink socket: %s\n", strerror(errno));
+        close(netlinkFd);
+        netlinkFd = -1;
+        return;
+    }
+
+    FSC_LOG(LOG_SEV_INFO, "Watching WAN interface %s\n", wanInterface);
+    resync();
+}
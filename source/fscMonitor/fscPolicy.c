@@ -0,0 +1,109 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscPolicy.c
+ * @brief Timeout policy of the check
+ *
+ * Decides how long the hal timeout is armed for and when the check gives up. Kept apart from the
+ * main routine so the fleet simulator runs the very same decisions.
+ */
+
+#include "fscMonitor.h"
+
+// 60 minute timeout value (in seconds), but we will shift the time by 5 minutes to account for the startup offset.
+#define FSC_TIMEOUT_VALUE 60*60
+#define FSC_TIME_OFFSET 300
+#define FSC_SAMPLE_INTERVAL 30
+
+// Progress-aware mode: the hal is first armed with a short window which is re-armed in increments
+// while the device shows forward progress, never exceeding FSC_TIMEOUT_VALUE in total.
+#define FSC_PROGRESS_INITIAL_TIMEOUT 15*60
+#define FSC_PROGRESS_EXTEND_VALUE 10*60
+
+// Time the hal is given to take the verdict, as long as fscHal waits for it
+#define FSC_VERDICT_RESERVE 120
+
+void fscPolicyDefaults(fscPolicyConfig_t *config)
+{
+    config->sampleInterval = FSC_SAMPLE_INTERVAL;
+    config->timeOffset = FSC_TIME_OFFSET;
+    config->maxTimeout = FSC_TIMEOUT_VALUE;
+    config->bProgressive = FALSE;
+    config->initialTimeout = FSC_PROGRESS_INITIAL_TIMEOUT;
+    config->extendValue = FSC_PROGRESS_EXTEND_VALUE;
+    config->verdictReserve = FSC_VERDICT_RESERVE;
+}
+
+/*
+ * Start a check, policy->halTimeout is what the hal is to be armed with
+ */
+void fscPolicyInit(fscPolicy_t *policy, const fscPolicyConfig_t *config)
+{
+    policy->config = config;
+    policy->halTimeout = config->bProgressive ? config->initialTimeout : config->maxTimeout;
+    policy->expiryTime = (double) (policy->halTimeout - config->timeOffset); // adjust expiry time by 5 minutes
+    policy->halDeadline = (double) policy->halTimeout;
+    policy->worstSample = 0;
+}
+
+/*
+ * Progress was seen at elapsedTime, returns the timeout the hal is to be re-armed with or 0 if
+ * the expiry does not move
+ */
+int fscPolicyProgress(fscPolicy_t *policy, double elapsedTime)
+{
+    const fscPolicyConfig_t *config = policy->config;
+    double newExpiry = elapsedTime + config->extendValue;
+
+    if (!config->bProgressive)
+        return 0;
+
+    if (newExpiry > (double) (config->maxTimeout - config->timeOffset))
+        newExpiry = (double) (config->maxTimeout - config->timeOffset);
+
+    // Only re-arm the hal when this actually moves the expiry out
+    if (newExpiry <= policy->expiryTime)
+        return 0;
+
+    policy->expiryTime = newExpiry;
+    policy->halTimeout = (int) (policy->expiryTime - elapsedTime) + config->timeOffset;
+    policy->halDeadline = elapsedTime + policy->halTimeout;
+    return policy->halTimeout;
+}
+
+/*
+ * A sample took this long, from waking up to being done with the probes
+ */
+void fscPolicySampleTime(fscPolicy_t *policy, double seconds)
+{
+    if (seconds > policy->worstSample)
+        policy->worstSample = seconds;
+}
+
+/*
+ * The check gives up at the expiry time, or earlier once samples are so slow that waiting for the
+ * next one would leave the hal too little time to take the verdict before its own timeout fires
+ */
+BOOLEAN fscPolicyExpired(const fscPolicy_t *policy, double elapsedTime)
+{
+    const fscPolicyConfig_t *config = policy->config;
+
+    return elapsedTime >= policy->expiryTime ||
+           elapsedTime + config->sampleInterval + policy->worstSample + config->verdictReserve >= policy->halDeadline;
+}
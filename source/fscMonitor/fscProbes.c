@@ -0,0 +1,141 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscProbes.c
+ * @brief Fatal signal probes
+ *
+ * Definitive failure signals which allow the checker to give up on an image before the full
+ * validation window has expired:
+ *
+ *  - the kernel has oopsed since boot (TAINT_DIE in /proc/sys/kernel/tainted)
+ *  - the kernel log reports an oops, a panic or repeated OOM kills
+ *  - a known fatal string shows up in the followed log files, if enabled
+ *  - the image keeps rebooting before it gets validated
+ *  - a critical CCSP process keeps getting restarted
+ *  - sustained memory or CPU pressure, if enabled
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fscMonitor.h"
+
+#define FSC_TAINTED_FILE "/proc/sys/kernel/tainted"
+#define FSC_TAINT_DIE (1 << 7)
+
+// A critical process restarted this many times within the window is crash looping
+#define FSC_CRASH_LOOP_LIMIT 3
+#define FSC_CRASH_LOOP_WINDOW 10*60
+
+/*
+ * Kernel has oopsed since boot
+ */
+static BOOLEAN checkKernelOops(char *reason, size_t len)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    const char *file = FSC_TAINTED_FILE;
+    FILE *fp;
+    unsigned long tainted = 0;
+
+    // A replay sets the taint flags in its root, those of this host do not count
+    if (fscReplayActive())
+        file = fscRootPath(FSC_TAINTED_FILE, path, sizeof(path));
+
+    if ((fp = fopen(file, "r")) == NULL)
+        return FALSE;
+
+    if (fscanf(fp, "%lu", &tainted) != 1)
+        tainted = 0;
+    fclose(fp);
+
+    if (tainted & FSC_TAINT_DIE) {
+        snprintf(reason, len, "kernel oops detected (tainted 0x%lx)", tainted);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Critical process is crash looping, i.e. exited too many times within the window
+ */
+static BOOLEAN checkCrashLoop(char *reason, size_t len)
+{
+    int restarts;
+    int i;
+
+    for (i = 0; i < fscProcCount(); i++) {
+        restarts = fscProcRestartsInWindow(i, FSC_CRASH_LOOP_WINDOW);
+        if (restarts >= FSC_CRASH_LOOP_LIMIT) {
+            snprintf(reason, len, "%s crash looping (%d restarts in %d seconds)", fscProcName(i), restarts, FSC_CRASH_LOOP_WINDOW);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+typedef struct {
+    const char *name;
+    BOOLEAN (*check)(char *reason, size_t len);
+} fscFatalProbe_t;
+
+static const fscFatalProbe_t fatalProbes[] = {
+    { "bootloop",  fscBootRecordIsLooping },
+    { "oops",      checkKernelOops },
+    { "kmsg",      fscKmsgCheckFatal },
+    { "crashloop", checkCrashLoop },
+    { "pressure",  fscPsiCheckFatal },
+    { "logs",      fscLogWatchCheckFatal },
+};
+
+/*
+ * Count this boot against the image. The boot record is cleared once the image is validated.
+ */
+void fscProbesInit(void)
+{
+    fscBootRecordInit();
+}
+
+/*
+ * Run all fatal probes, returns TRUE with the reason filled in if any of them fired
+ */
+BOOLEAN fscCheckFatalSignals(char *reason, size_t len)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(fatalProbes) / sizeof(fatalProbes[0])); i++) {
+        if (fatalProbes[i].check(reason, len)) {
+            FSC_LOG(LOG_SEV_ERROR, "Fatal probe %s: %s\n", fatalProbes[i].name, reason);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Verdict has been reached, either way it ends the boot attempts of the image
+ */
+void fscProbesVerdict(BOOLEAN bValidImage)
+{
+    fscBootRecordVerdict(bValidImage);
+}
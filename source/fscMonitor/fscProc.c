@@ -0,0 +1,479 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscProc.c
+ * @brief Critical process presence probe
+ *
+ * Tracks the pids of the critical CCSP processes. This has to stay cheap with several hundred
+ * processes on a single core, so:
+ *
+ *  - the names are compiled into a small hash set once at startup
+ *  - a full scan is a single readdir pass over /proc, kept open between scans
+ *  - only /proc/<pid>/comm is read, with pread into a reused buffer
+ *  - every pid seen is cached together with the inode of its /proc directory, which readdir hands
+ *    us for free, so comm is only read for pids we have not seen before
+ *  - while all processes are known, a refresh only stats their /proc directories and the full
+ *    scan is skipped altogether
+ *
+ * Where the kernel supports it we also hold a pidfd for every tracked process and wait for it to
+ * exit in the event loop. Exits are then seen the instant they happen, even if the process is
+ * restarted between two samples, and the processes are not polled at all. Every exit counts as a
+ * restart; the last few exit times are kept so restarts can be counted over a sliding window.
+ * After an exit /proc is rescanned every second until the new instance shows up, so we can watch
+ * it in turn.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+#include "fscMonitor.h"
+
+#define FSC_PROC_NAME_LEN 16            // TASK_COMM_LEN, comm is truncated to 15 characters
+#define FSC_PROC_HASH_SIZE 64           // power of 2, at least 2x FSC_PROC_MAX_PROCESSES
+#define FSC_PROC_CACHE_SIZE 4096        // power of 2, direct mapped by pid
+#define FSC_PROC_EXIT_HISTORY 8
+#define FSC_PROC_RESCAN_INTERVAL 1
+#define FSC_PROC_REPLAY_PID 0x7fffffff  // not a real pid, nothing is ever found for it in /proc
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+typedef struct {
+    char name[FSC_PROC_NAME_LEN];
+    pid_t pid;
+    ino_t ino;
+    int pidfd;
+    int restarts;
+    double exitTimes[FSC_PROC_EXIT_HISTORY];
+} fscProcess_t;
+
+typedef struct {
+    pid_t pid;
+    ino_t ino;
+    int match;                          // index into processes or -1
+} fscPidCacheEntry_t;
+
+static const char *defaultProcesses = "CcspCrSsp,PsmSsp,CcspPandMSsp,CcspWifiSsp";
+
+static fscProcess_t processes[FSC_PROC_MAX_PROCESSES];
+static int numProcesses = 0;
+
+// Open addressed set of name hashes, holds process index + 1 (0 is empty)
+static uint32_t nameHashes[FSC_PROC_HASH_SIZE];
+static int nameSlots[FSC_PROC_HASH_SIZE];
+
+static fscPidCacheEntry_t pidCache[FSC_PROC_CACHE_SIZE];
+static DIR *procDir = NULL;
+static char commBuf[FSC_PROC_NAME_LEN + 1];
+static BOOLEAN bPidfdSupported = TRUE;
+static int rescanTimer = -1;
+static BOOLEAN bRescanArmed = FALSE;
+
+static uint32_t nameHash(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int nameLookup(const char *name, size_t len)
+{
+    uint32_t hash = nameHash(name, len);
+    uint32_t slot = hash & (FSC_PROC_HASH_SIZE - 1);
+    int idx;
+
+    while (nameSlots[slot] != 0) {
+        idx = nameSlots[slot] - 1;
+        if (nameHashes[slot] == hash && strlen(processes[idx].name) == len &&
+            memcmp(processes[idx].name, name, len) == 0) {
+            return idx;
+        }
+        slot = (slot + 1) & (FSC_PROC_HASH_SIZE - 1);
+    }
+
+    return -1;
+}
+
+static void nameInsert(int idx)
+{
+    uint32_t hash = nameHash(processes[idx].name, strlen(processes[idx].name));
+    uint32_t slot = hash & (FSC_PROC_HASH_SIZE - 1);
+
+    while (nameSlots[slot] != 0)
+        slot = (slot + 1) & (FSC_PROC_HASH_SIZE - 1);
+
+    nameHashes[slot] = hash;
+    nameSlots[slot] = idx + 1;
+}
+
+/*
+ * Read the comm of a pid, returns its length or -1
+ */
+static int readComm(pid_t pid)
+{
+    char path[32];
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%d/comm", (int)pid);
+    if ((fd = openat(dirfd(procDir), path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+
+    len = pread(fd, commBuf, FSC_PROC_NAME_LEN, 0);
+    close(fd);
+
+    if (len <= 0)
+        return -1;
+
+    fscMetricsAdd(FSC_METRIC_BYTES_READ, (uint64_t)len);
+    if (commBuf[len - 1] == '\n')
+        len--;
+
+    return (int)len;
+}
+
+/*
+ * The tracked instance of a process is gone, either seen through its pidfd or by a scan
+ */
+static void processExited(int idx)
+{
+    fscProcess_t *proc = &processes[idx];
+    fscPidCacheEntry_t *entry;
+
+    if (proc->pidfd >= 0) {
+        fscLoopRemove(proc->pidfd);
+        close(proc->pidfd);
+        proc->pidfd = -1;
+    }
+
+    proc->exitTimes[proc->restarts % FSC_PROC_EXIT_HISTORY] = fscMonotonicTime();
+    proc->restarts++;
+    FSC_LOG(LOG_SEV_WARN, "%s (pid %d) exited, %d restarts\n", proc->name, (int)proc->pid, proc->restarts);
+
+    // Until it is reaped the dead instance still shows up in /proc, make sure we do not pick it up again
+    entry = &pidCache[proc->pid & (FSC_PROC_CACHE_SIZE - 1)];
+    if (entry->pid == proc->pid && entry->ino == proc->ino)
+        entry->match = -1;
+
+    proc->pid = 0;
+    proc->ino = 0;
+}
+
+/*
+ * Start or stop the periodic rescan used to pick up restarted processes
+ */
+static void armRescan(BOOLEAN bArm)
+{
+    if (rescanTimer < 0 || bArm == bRescanArmed)
+        return;
+
+    if (bArm)
+        fscLoopTimerArm(rescanTimer, FSC_PROC_RESCAN_INTERVAL, FSC_PROC_RESCAN_INTERVAL);
+    else
+        fscLoopTimerDisarm(rescanTimer);
+    bRescanArmed = bArm;
+}
+
+static void rescanHandle(void *ctx)
+{
+    (void)ctx;
+
+    fscProcRefresh();
+}
+
+static void pidfdHandle(int fd, uint32_t events, void *ctx)
+{
+    (void)fd;
+    (void)events;
+
+    processExited((int)(intptr_t)ctx);
+    armRescan(TRUE);
+
+    // Take a sample right away so a crash loop is acted upon immediately
+    fscRequestRecheck();
+}
+
+/*
+ * Start waiting for the exit of a newly found process
+ */
+static void watchProcess(int idx)
+{
+    fscProcess_t *proc = &processes[idx];
+    struct stat st;
+    char path[16];
+    int fd;
+
+    if (!bPidfdSupported || proc->pidfd >= 0)
+        return;
+
+    if ((fd = (int)syscall(SYS_pidfd_open, proc->pid, 0)) < 0) {
+        if (errno == ENOSYS) {
+            FSC_LOG(LOG_SEV_INFO, "pidfd not supported, process exits are only seen by polling\n");
+            bPidfdSupported = FALSE;
+        }
+        return;
+    }
+
+    // Make sure the pid was not recycled between the scan and pidfd_open()
+    snprintf(path, sizeof(path), "%d", (int)proc->pid);
+    if (fstatat(dirfd(procDir), path, &st, 0) != 0 || st.st_ino != proc->ino ||
+        fscLoopAdd(fd, EPOLLIN, pidfdHandle, (void *)(intptr_t)idx) != 0) {
+        close(fd);
+        return;
+    }
+
+    proc->pidfd = fd;
+}
+
+/*
+ * Single readdir pass over /proc
+ */
+static void fullScan(void)
+{
+    pid_t found[FSC_PROC_MAX_PROCESSES] = {0};
+    ino_t foundIno[FSC_PROC_MAX_PROCESSES] = {0};
+    fscPidCacheEntry_t *entry;
+    struct dirent *de;
+    pid_t pid;
+    int len, i;
+
+    rewinddir(procDir);
+    while ((de = readdir(procDir)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0]))
+            continue;
+
+        pid = (pid_t)atoi(de->d_name);
+        entry = &pidCache[pid & (FSC_PROC_CACHE_SIZE - 1)];
+
+        if (entry->pid != pid || entry->ino != de->d_ino) {
+            entry->pid = pid;
+            entry->ino = de->d_ino;
+            entry->match = ((len = readComm(pid)) > 0) ? nameLookup(commBuf, (size_t)len) : -1;
+        }
+
+        if (entry->match >= 0) {
+            found[entry->match] = pid;
+            foundIno[entry->match] = de->d_ino;
+        }
+    }
+
+    for (i = 0; i < numProcesses; i++) {
+        if (processes[i].pid == found[i] && processes[i].ino == foundIno[i])
+            continue;
+
+        // Exit not seen through a pidfd yet, or pidfds are not available
+        if (processes[i].pid != 0)
+            processExited(i);
+
+        processes[i].pid = found[i];
+        processes[i].ino = foundIno[i];
+        if (found[i] != 0)
+            watchProcess(i);
+    }
+}
+
+/*
+ * Set the processes to track from a comma separated list of names, returns -1 on error
+ */
+int fscProcSetProcesses(const char *list)
+{
+    char buf[512];
+    char *name, *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    memset(nameSlots, 0, sizeof(nameSlots));
+    numProcesses = 0;
+
+    for (name = strtok_r(buf, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        if (numProcesses == FSC_PROC_MAX_PROCESSES) {
+            fprintf(stderr, "Too many processes, at most %d can be tracked\n", FSC_PROC_MAX_PROCESSES);
+            return -1;
+        }
+
+        // Names are matched against comm, which the kernel truncates
+        snprintf(processes[numProcesses].name, FSC_PROC_NAME_LEN, "%s", name);
+        processes[numProcesses].pid = 0;
+        processes[numProcesses].pidfd = -1;
+        processes[numProcesses].restarts = 0;
+        if (nameLookup(processes[numProcesses].name, strlen(processes[numProcesses].name)) >= 0)
+            continue;
+
+        nameInsert(numProcesses);
+        numProcesses++;
+    }
+
+    return 0;
+}
+
+/*
+ * Open /proc and take the initial scan
+ */
+void fscProcInit(void)
+{
+    if (numProcesses == 0)
+        fscProcSetProcesses(defaultProcesses);
+
+    // A replay decides which processes are running, the ones on this host do not count
+    if (fscReplayActive())
+        return;
+
+    if ((procDir = opendir("/proc")) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening /proc\n");
+        return;
+    }
+
+    rescanTimer = fscLoopTimerAdd(rescanHandle, NULL);
+
+    fullScan();
+}
+
+/*
+ * Refresh the pids of the tracked processes. While all of them are known and still alive only
+ * the /proc directories of those without a pidfd are checked.
+ */
+void fscProcRefresh(void)
+{
+    struct stat st;
+    char path[16];
+    int i;
+
+    if (procDir == NULL)
+        return;
+
+    for (i = 0; i < numProcesses; i++) {
+        if (processes[i].pid == 0)
+            break;
+
+        if (processes[i].pidfd >= 0)
+            continue;
+
+        snprintf(path, sizeof(path), "%d", (int)processes[i].pid);
+        if (fstatat(dirfd(procDir), path, &st, 0) != 0 || st.st_ino != processes[i].ino)
+            break;
+    }
+
+    if (i < numProcesses)
+        fullScan();
+
+    // Keep rescanning while a process which exited has not come back yet
+    for (i = 0; i < numProcesses; i++) {
+        if (processes[i].pid == 0 && processes[i].restarts > 0)
+            break;
+    }
+    armRescan(i < numProcesses);
+}
+
+/*
+ * A replayed process start or exit, returns -1 if the process is not tracked
+ */
+int fscProcInject(const char *name, BOOLEAN bRunning)
+{
+    size_t len = strlen(name);
+    int idx;
+
+    if ((idx = nameLookup(name, (len < FSC_PROC_NAME_LEN) ? len : FSC_PROC_NAME_LEN - 1)) < 0)
+        return -1;
+
+    if (bRunning && processes[idx].pid == 0) {
+        processes[idx].pid = FSC_PROC_REPLAY_PID;
+        FSC_LOG(LOG_SEV_INFO, "%s started\n", processes[idx].name);
+    } else if (!bRunning && processes[idx].pid != 0) {
+        processExited(idx);
+        fscRequestRecheck();
+    }
+
+    return 0;
+}
+
+int fscProcCount(void)
+{
+    return numProcesses;
+}
+
+const char *fscProcName(int idx)
+{
+    return processes[idx].name;
+}
+
+/*
+ * Pid of a tracked process as of the last refresh, 0 if it is not running
+ */
+pid_t fscProcPid(int idx)
+{
+    return processes[idx].pid;
+}
+
+/*
+ * Number of times a tracked process exited since we started
+ */
+int fscProcRestarts(int idx)
+{
+    return processes[idx].restarts;
+}
+
+/*
+ * Number of times a tracked process exited within the last window seconds
+ */
+int fscProcRestartsInWindow(int idx, double window)
+{
+    fscProcess_t *proc = &processes[idx];
+    double now = fscMonotonicTime();
+    int n = (proc->restarts < FSC_PROC_EXIT_HISTORY) ? proc->restarts : FSC_PROC_EXIT_HISTORY;
+    int count = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (now - proc->exitTimes[i] <= window)
+            count++;
+    }
+
+    return count;
+}
+
+/*
+ * Check to see if all tracked processes were running at the last refresh
+ */
+BOOLEAN fscProcAllRunning(void)
+{
+    int i;
+
+    for (i = 0; i < numProcesses; i++) {
+        if (processes[i].pid == 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,321 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscProfile.c
+ * @brief Resource sampler
+ *
+ * Samples /proc/stat, /proc/meminfo and /proc/loadavg from a timer in the event loop into a fixed
+ * ring, and deflates the ring into a single blob in /nvram once the verdict is reached. The proc
+ * files are kept open and re-read with pread, so a sample costs three syscalls. CPU times are
+ * stored as deltas, which keeps the samples small and compresses well.
+ *
+ * At intervals of 5 seconds and up the ring covers the whole validation window, with shorter
+ * intervals the oldest samples are overwritten.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "fscMonitor.h"
+#include "fscProfile.h"
+
+#define FSC_PROFILE_TMP_FILE "/nvram/fscProfile.tmp"
+#define FSC_PROFILE_RING_SIZE 720
+
+typedef struct {
+    unsigned long long user, system, idle, iowait, irq;
+} fscCpuTimes_t;
+
+static fscProfileSample_t ring[FSC_PROFILE_RING_SIZE];
+static uint32_t head = 0;
+static uint32_t count = 0;
+static uint32_t dropped = 0;
+static int interval = 0;
+static int sampleTimer = -1;
+static int statFd = -1;
+static int meminfoFd = -1;
+static int loadavgFd = -1;
+static fscCpuTimes_t lastCpu;
+
+static ssize_t readProc(int fd, char *buf, size_t len)
+{
+    ssize_t n = pread(fd, buf, len - 1, 0);
+
+    buf[(n > 0) ? n : 0] = 0;
+    if (n > 0)
+        fscMetricsAdd(FSC_METRIC_BYTES_READ, n);
+    return n;
+}
+
+static BOOLEAN readCpu(fscCpuTimes_t *cpu)
+{
+    unsigned long long user, nice, system, idle, iowait, irq, softirq;
+    char buf[256];
+
+    // Only the aggregate line at the very start is needed
+    if (readProc(statFd, buf, sizeof(buf)) <= 0 ||
+        sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq) != 7)
+        return FALSE;
+
+    cpu->user = user + nice;
+    cpu->system = system;
+    cpu->idle = idle;
+    cpu->iowait = iowait;
+    cpu->irq = irq + softirq;
+    return TRUE;
+}
+
+static uint32_t meminfoField(const char *buf, const char *name)
+{
+    unsigned long kb = 0;
+    const char *p = strstr(buf, name);
+
+    if (p != NULL)
+        sscanf(p + strlen(name), " %lu", &kb);
+    return (uint32_t)kb;
+}
+
+static void readMeminfo(fscProfileSample_t *sample)
+{
+    char buf[2048];
+
+    if (readProc(meminfoFd, buf, sizeof(buf)) <= 0)
+        return;
+
+    sample->memFreeKb = meminfoField(buf, "\nMemFree:");
+    sample->memAvailableKb = meminfoField(buf, "\nMemAvailable:");
+    sample->cachedKb = meminfoField(buf, "\nCached:");
+}
+
+static void readLoadavg(fscProfileSample_t *sample)
+{
+    double load1, load5, load15;
+    unsigned int running, threads;
+    char buf[128];
+
+    if (readProc(loadavgFd, buf, sizeof(buf)) <= 0 ||
+        sscanf(buf, "%lf %lf %lf %u/%u", &load1, &load5, &load15, &running, &threads) != 5)
+        return;
+
+    sample->load1 = (uint16_t)(load1 * 100);
+    sample->load5 = (uint16_t)(load5 * 100);
+    sample->load15 = (uint16_t)(load15 * 100);
+    sample->running = (uint16_t)running;
+    sample->threads = (uint16_t)threads;
+}
+
+static void takeSample(void)
+{
+    fscProfileSample_t *sample = &ring[head];
+    fscCpuTimes_t cpu;
+
+    memset(sample, 0, sizeof(*sample));
+    sample->uptimeMs = (uint32_t)(fscClockUptime() * 1000.0);
+
+    if (readCpu(&cpu)) {
+        sample->cpuUser = (uint32_t)(cpu.user - lastCpu.user);
+        sample->cpuSystem = (uint32_t)(cpu.system - lastCpu.system);
+        sample->cpuIdle = (uint32_t)(cpu.idle - lastCpu.idle);
+        sample->cpuIowait = (uint32_t)(cpu.iowait - lastCpu.iowait);
+        sample->cpuIrq = (uint32_t)(cpu.irq - lastCpu.irq);
+        lastCpu = cpu;
+    }
+    readMeminfo(sample);
+    readLoadavg(sample);
+
+    head = (head + 1) % FSC_PROFILE_RING_SIZE;
+    if (count < FSC_PROFILE_RING_SIZE)
+        count++;
+    else
+        dropped++;
+}
+
+static void timerHandle(void *ctx)
+{
+    (void)ctx;
+
+    takeSample();
+}
+
+/*
+ * Sample interval in seconds, sampling is off unless this is set
+ */
+int fscProfileSetInterval(const char *seconds)
+{
+    char *end;
+    long value = strtol(seconds, &end, 10);
+
+    if (*end != 0 || value <= 0 || value > 3600) {
+        fprintf(stderr, "Invalid resource sample interval %s\n", seconds);
+        return -1;
+    }
+
+    interval = (int)value;
+    return 0;
+}
+
+/*
+ * Open the proc files and start the sample timer
+ */
+void fscProfileInit(void)
+{
+    if (interval == 0)
+        return;
+
+    statFd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    meminfoFd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    loadavgFd = open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+    if (statFd < 0 || meminfoFd < 0 || loadavgFd < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening proc files, resource sampling disabled\n");
+        fscProfileShutdown();
+        interval = 0;
+        return;
+    }
+
+    if ((sampleTimer = fscLoopTimerAdd(timerHandle, NULL)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating the sample timer, resource sampling disabled\n");
+        fscProfileShutdown();
+        interval = 0;
+        return;
+    }
+
+    fscLoopTimerArm(sampleTimer, interval, interval);
+
+    // The first sample is the reference the cpu deltas start from
+    readCpu(&lastCpu);
+    takeSample();
+
+    FSC_LOG(LOG_SEV_INFO, "Sampling resource usage every %d seconds\n", interval);
+}
+
+/*
+ * Stop sampling
+ */
+void fscProfileShutdown(void)
+{
+    if (sampleTimer >= 0) {
+        fscLoopTimerRemove(sampleTimer);
+        sampleTimer = -1;
+    }
+    if (statFd >= 0) {
+        close(statFd);
+        statFd = -1;
+    }
+    if (meminfoFd >= 0) {
+        close(meminfoFd);
+        meminfoFd = -1;
+    }
+    if (loadavgFd >= 0) {
+        close(loadavgFd);
+        loadavgFd = -1;
+    }
+}
+
+/*
+ * Replace the previous profile in one go so a power cut never leaves a torn blob behind
+ */
+static BOOLEAN profileWrite(const fscProfileHeader_t *header, const Bytef *data, size_t len)
+{
+    char path[FSC_ROOT_PATH_LEN], tmpPath[FSC_ROOT_PATH_LEN];
+    const char *file = fscRootPath(FSC_PROFILE_FILE, path, sizeof(path));
+    const char *tmpFile = fscRootPath(FSC_PROFILE_TMP_FILE, tmpPath, sizeof(tmpPath));
+    int fd;
+
+    if ((fd = open(tmpFile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error opening %s \n", tmpFile);
+        return FALSE;
+    }
+
+    if (write(fd, header, sizeof(*header)) != (ssize_t)sizeof(*header) ||
+        write(fd, data, len) != (ssize_t)len || fdatasync(fd) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error writing %s \n", tmpFile);
+        close(fd);
+        unlink(tmpFile);
+        return FALSE;
+    }
+    close(fd);
+
+    if (rename(tmpFile, file) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error renaming %s \n", tmpFile);
+        unlink(tmpFile);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Deflate the ring, oldest sample first, and store it together with the verdict
+ */
+void fscProfileStore(BOOLEAN bValid)
+{
+    fscProfileHeader_t header;
+    fscProfileSample_t *samples;
+    char imageName[256] = {0};
+    uint32_t first = (head + FSC_PROFILE_RING_SIZE - count) % FSC_PROFILE_RING_SIZE;
+    size_t rawSize = count * sizeof(fscProfileSample_t);
+    uLongf compressedSize = compressBound(rawSize);
+    Bytef *compressed;
+    uint32_t i;
+
+    if (interval == 0 || count == 0)
+        return;
+
+    fscProfileShutdown();
+
+    samples = malloc(rawSize);
+    compressed = malloc(compressedSize);
+    if (samples == NULL || compressed == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Out of memory storing the resource profile\n");
+        free(samples);
+        free(compressed);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+        samples[i] = ring[(first + i) % FSC_PROFILE_RING_SIZE];
+
+    if (compress2(compressed, &compressedSize, (const Bytef *)samples, rawSize, Z_BEST_COMPRESSION) == Z_OK) {
+        memset(&header, 0, sizeof(header));
+        header.magic = FSC_PROFILE_MAGIC;
+        header.version = FSC_PROFILE_VERSION;
+        if (fscGetImageName(imageName, sizeof(imageName)))
+            header.image = (uint32_t)crc32(0L, (const Bytef *)imageName, strlen(imageName));
+        header.verdict = bValid ? FSC_VERDICT_VALID : FSC_VERDICT_INVALID;
+        header.interval = (uint32_t)interval;
+        header.count = count;
+        header.dropped = dropped;
+        header.compressedSize = (uint32_t)compressedSize;
+        header.crc = (uint32_t)crc32(0L, compressed, compressedSize);
+
+        if (profileWrite(&header, compressed, compressedSize))
+            FSC_LOG(LOG_SEV_INFO, "Stored %u resource samples in %lu bytes (%lu raw)\n", count,
+                    (unsigned long)(sizeof(header) + compressedSize), (unsigned long)rawSize);
+    } else {
+        FSC_LOG(LOG_SEV_ERROR, "Error compressing the resource profile\n");
+    }
+
+    free(samples);
+    free(compressed);
+}
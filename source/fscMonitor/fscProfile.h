@@ -0,0 +1,77 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscProfile.h
+ * @brief Resource profile of the validation window
+ *
+ * fscMonitor can sample /proc/stat, /proc/meminfo and /proc/loadavg during the validation window.
+ * When the verdict is reached the samples are deflated and stored as a single blob in /nvram: a
+ * fscProfileHeader_t followed by the zlib stream of fscProfileSample_t entries, oldest first.
+ *
+ * fscctl profile decodes the blob.
+ */
+
+#ifndef FSC_PROFILE_H
+#define FSC_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FSC_PROFILE_FILE "/nvram/fscProfile"
+#define FSC_PROFILE_MAGIC 0x46534350 /* "FSCP" */
+#define FSC_PROFILE_VERSION 1
+
+typedef struct {
+    uint32_t uptimeMs;          // uptime of the sample
+    uint32_t cpuUser;           // jiffies since the previous sample, user and nice
+    uint32_t cpuSystem;         // system
+    uint32_t cpuIdle;           // idle
+    uint32_t cpuIowait;         // iowait
+    uint32_t cpuIrq;            // irq and softirq
+    uint32_t memAvailableKb;
+    uint32_t memFreeKb;
+    uint32_t cachedKb;
+    uint16_t load1;             // load averages times 100
+    uint16_t load5;
+    uint16_t load15;
+    uint16_t running;           // runnable scheduling entities
+    uint16_t threads;           // total scheduling entities
+    uint16_t reserved;
+} fscProfileSample_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t image;             // crc of the imagename
+    uint32_t verdict;           // eFscVerdict
+    uint32_t interval;          // sample interval in seconds
+    uint32_t count;             // number of samples
+    uint32_t dropped;           // samples overwritten in the ring
+    uint32_t compressedSize;    // bytes of zlib data following the header
+    uint32_t crc;               // crc of the zlib data
+} fscProfileHeader_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSC_PROFILE_H */
@@ -0,0 +1,243 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscPsi.c
+ * @brief Memory and CPU pressure probe
+ *
+ * A new image which thrashes memory may still get an xconf reply. This probe registers kernel PSI
+ * triggers on /proc/pressure/memory and /proc/pressure/cpu in the event loop, so stalls are seen
+ * as they happen without polling, and samples the 60 second averages with every sample. Pressure
+ * above the threshold for several samples in a row is sustained pressure, which is flagged on the
+ * status page and can optionally fail the image.
+ *
+ * The stall totals over the validation window are logged when the check ends.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "fscMonitor.h"
+
+// Number of consecutive samples above the threshold which count as sustained pressure
+#define FSC_PSI_SUSTAINED_SAMPLES 3
+
+typedef struct {
+    const char *name;
+    const char *path;
+    const char *trigger;        // written to the trigger fd: <some|full> <stall us> <window us>
+    const char *line;           // line the threshold applies to
+    double threshold;           // avg60 percentage
+    int triggerFd;
+    int readFd;
+    unsigned long long startTotal;
+    unsigned long long total;
+    double avg60;
+    uint32_t events;
+    int highSamples;
+} fscPsiResource_t;
+
+// Trigger windows are kept at a multiple of 2 seconds, which is all newer kernels accept without
+// CAP_SYS_RESOURCE
+static fscPsiResource_t psiResources[] = {
+    { "memory", "/proc/pressure/memory", "full 200000 2000000", "full", 10.0, -1, -1, 0, 0, 0, 0, 0 },
+    { "cpu",    "/proc/pressure/cpu",    "some 1000000 2000000", "some", 90.0, -1, -1, 0, 0, 0, 0, 0 },
+};
+#define NUM_PSI_RESOURCES (int)(sizeof(psiResources) / sizeof(psiResources[0]))
+
+static BOOLEAN bPsiEnabled = FALSE;
+static BOOLEAN bPsiFail = FALSE;
+
+/*
+ * Read the averages and total stall time of the threshold line
+ */
+static BOOLEAN readPressure(fscPsiResource_t *res)
+{
+    char buf[256];
+    char *line;
+    ssize_t len;
+    double avg10, avg60, avg300;
+    unsigned long long total;
+
+    if (res->readFd < 0 || (len = pread(res->readFd, buf, sizeof(buf) - 1, 0)) <= 0)
+        return FALSE;
+    buf[len] = 0;
+    fscMetricsAdd(FSC_METRIC_BYTES_READ, (uint64_t)len);
+
+    for (line = buf; line != NULL && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        if (strncmp(line, res->line, 4) != 0)
+            continue;
+
+        if (sscanf(line + 4, " avg10=%lf avg60=%lf avg300=%lf total=%llu", &avg10, &avg60, &avg300, &total) != 4)
+            return FALSE;
+
+        res->avg60 = avg60;
+        res->total = total;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void psiTriggerHandle(int fd, uint32_t events, void *ctx)
+{
+    fscPsiResource_t *res = (fscPsiResource_t *)ctx;
+
+    if (events & EPOLLERR) {
+        FSC_LOG(LOG_SEV_WARN, "%s pressure trigger went away\n", res->name);
+        fscLoopRemove(fd);
+        close(fd);
+        res->triggerFd = -1;
+        return;
+    }
+
+    if (res->events++ == 0)
+        FSC_LOG(LOG_SEV_WARN, "%s pressure stall trigger fired (%s)\n", res->name, res->trigger);
+}
+
+/*
+ * Enable the probe, optionally failing the image on sustained pressure
+ */
+void fscPsiEnable(BOOLEAN bFail)
+{
+    bPsiEnabled = TRUE;
+    bPsiFail = bFail;
+}
+
+/*
+ * Open the pressure files and register the triggers with the event loop
+ */
+void fscPsiInit(void)
+{
+    fscPsiResource_t *res;
+    int i;
+
+    if (!bPsiEnabled)
+        return;
+
+    for (i = 0; i < NUM_PSI_RESOURCES; i++) {
+        res = &psiResources[i];
+
+        if ((res->readFd = open(res->path, O_RDONLY | O_CLOEXEC)) < 0) {
+            FSC_LOG(LOG_SEV_WARN, "%s not available, %s pressure is not monitored\n", res->path, res->name);
+            continue;
+        }
+        readPressure(res);
+        res->startTotal = res->total;
+
+        if ((res->triggerFd = open(res->path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0)
+            continue;
+
+        if (write(res->triggerFd, res->trigger, strlen(res->trigger) + 1) < 0 ||
+            fscLoopAdd(res->triggerFd, EPOLLPRI, psiTriggerHandle, res) != 0) {
+            FSC_LOG(LOG_SEV_WARN, "Error registering %s pressure trigger: %s\n", res->name, strerror(errno));
+            close(res->triggerFd);
+            res->triggerFd = -1;
+        }
+    }
+}
+
+/*
+ * Sample the pressure averages, returns TRUE if any resource is above its threshold
+ */
+BOOLEAN fscPsiSample(void)
+{
+    fscPsiResource_t *res;
+    BOOLEAN bHigh = FALSE;
+    int i;
+
+    if (!bPsiEnabled)
+        return FALSE;
+
+    for (i = 0; i < NUM_PSI_RESOURCES; i++) {
+        res = &psiResources[i];
+
+        if (!readPressure(res))
+            continue;
+
+        if (res->avg60 >= res->threshold) {
+            if (res->highSamples++ == 0)
+                FSC_LOG(LOG_SEV_WARN, "%s pressure %s avg60 %.2f%% above threshold %.2f%%\n",
+                        res->name, res->line, res->avg60, res->threshold);
+            bHigh = TRUE;
+        } else {
+            res->highSamples = 0;
+        }
+    }
+
+    return bHigh;
+}
+
+/*
+ * Fatal probe, fires on sustained pressure if the probe was enabled to fail the image
+ */
+BOOLEAN fscPsiCheckFatal(char *reason, size_t len)
+{
+    int i;
+
+    if (!bPsiFail)
+        return FALSE;
+
+    for (i = 0; i < NUM_PSI_RESOURCES; i++) {
+        if (psiResources[i].highSamples >= FSC_PSI_SUSTAINED_SAMPLES) {
+            snprintf(reason, len, "sustained %s pressure (%s avg60 %.2f%%)", psiResources[i].name,
+                     psiResources[i].line, psiResources[i].avg60);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Stall time in milliseconds accumulated since the probe started
+ */
+uint32_t fscPsiStallMs(int resource)
+{
+    fscPsiResource_t *res = &psiResources[resource];
+
+    return (uint32_t)((res->total - res->startTotal) / 1000);
+}
+
+/*
+ * Log the stall totals over the validation window
+ */
+void fscPsiReport(double elapsedTime)
+{
+    fscPsiResource_t *res;
+    int i;
+
+    if (!bPsiEnabled)
+        return;
+
+    for (i = 0; i < NUM_PSI_RESOURCES; i++) {
+        res = &psiResources[i];
+        if (res->readFd < 0)
+            continue;
+
+        readPressure(res);
+        FSC_LOG(LOG_SEV_INFO, "%s pressure: %s stall %u ms over %.0f seconds (%.2f%%), %u trigger events\n",
+                res->name, res->line, fscPsiStallMs(i), elapsedTime,
+                (elapsedTime > 0) ? (double)(res->total - res->startTotal) / (elapsedTime * 10000.0) : 0.0,
+                res->events);
+    }
+}
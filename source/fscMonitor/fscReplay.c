@@ -0,0 +1,371 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscReplay.c
+ * @brief Replay of a recorded event trace
+ *
+ * Selected with --replay <trace>. The checker then runs on the virtual clock against the stub hal,
+ * and the events of the trace are applied as their time comes up. An hour long scenario runs in a
+ * few milliseconds, and the exit status tells whether the verdict came out as expected, so
+ * scenarios can be run by the thousand from a script.
+ *
+ * The trace holds one event per line, '#' starts a comment. Times are in seconds since the check
+ * started and must not decrease.
+ *
+ *   <time> create <path> [text]      file appears, holding text
+ *   <time> append <path> <text>      line added to a file, e.g. a log
+ *   <time> write <path> <text>       text added to a file without ending the line
+ *   <time> copy <path> <source>      file appears with the content of source, e.g. a recorded response
+ *   <time> touch <path>              file created or its mtime updated
+ *   <time> remove <path>
+ *   <time> start <process>           tracked process comes up
+ *   <time> exit <process>            tracked process exits, counted as a restart
+ *   <time> heartbeat <component>
+ *   <time> kmsg <message>            kernel log message
+ *   <time> hal <delay ms> <failures> behaviour of the following hal calls
+ *   <time> recheck                   sample right away, as fscctl recheck does
+ *   <time> expect valid|invalid      verdict which must be delivered by then
+ *
+ * Files get the virtual time as their mtime, which is what the progress markers and the boot
+ * milestones go by. Tracked processes and kernel messages only come from the trace, those of the
+ * host running the replay are ignored, and so are its taint flags: the kernel counts as tainted
+ * once the trace creates /proc/sys/kernel/tainted in the root. A replay must be given a private --root so it never touches
+ * the files of the device it runs on. Paths are taken under it, source files of copy are not.
+ *
+ * test/runReplay.sh runs the traces in test/replay, each in a root of its own, as part of make check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fscMonitor.h"
+
+#define FSC_REPLAY_LINE_LEN 1024
+
+typedef enum {
+    FSC_REPLAY_CREATE,
+    FSC_REPLAY_APPEND,
+    FSC_REPLAY_WRITE,
+    FSC_REPLAY_COPY,
+    FSC_REPLAY_TOUCH,
+    FSC_REPLAY_REMOVE,
+    FSC_REPLAY_START,
+    FSC_REPLAY_EXIT,
+    FSC_REPLAY_HEARTBEAT,
+    FSC_REPLAY_KMSG,
+    FSC_REPLAY_HAL,
+    FSC_REPLAY_RECHECK,
+    FSC_REPLAY_EXPECT
+} eFscReplayAction;
+
+static const struct {
+    const char *name;
+    eFscReplayAction action;
+    int minArgs;                // arg is the first word, arg2 the rest of the line
+    BOOLEAN bText;              // arg is the whole rest of the line
+} replayActions[] = {
+    { "create",    FSC_REPLAY_CREATE,    1, FALSE },
+    { "append",    FSC_REPLAY_APPEND,    2, FALSE },
+    { "write",     FSC_REPLAY_WRITE,     2, FALSE },
+    { "copy",      FSC_REPLAY_COPY,      2, FALSE },
+    { "touch",     FSC_REPLAY_TOUCH,     1, FALSE },
+    { "remove",    FSC_REPLAY_REMOVE,    1, FALSE },
+    { "start",     FSC_REPLAY_START,     1, FALSE },
+    { "exit",      FSC_REPLAY_EXIT,      1, FALSE },
+    { "heartbeat", FSC_REPLAY_HEARTBEAT, 1, FALSE },
+    { "kmsg",      FSC_REPLAY_KMSG,      1, TRUE },
+    { "hal",       FSC_REPLAY_HAL,       2, FALSE },
+    { "recheck",   FSC_REPLAY_RECHECK,   0, FALSE },
+    { "expect",    FSC_REPLAY_EXPECT,    1, FALSE },
+};
+#define NUM_REPLAY_ACTIONS (int)(sizeof(replayActions) / sizeof(replayActions[0]))
+
+typedef struct {
+    double time;
+    eFscReplayAction action;
+    char *arg;
+    char *arg2;
+} fscReplayEvent_t;
+
+static BOOLEAN bReplay = FALSE;
+static fscReplayEvent_t *events = NULL;
+static int numEvents = 0;
+static int maxEvents = 0;
+static int nextEvent = 0;
+static int replayTimer = -1;
+static double startTime;
+static struct timespec realStart;
+
+// Expected verdict, expectTime < 0 if the trace has none
+static BOOLEAN bExpectValid = FALSE;
+static double expectTime = -1;
+
+static char *nextWord(char *p)
+{
+    while (*p != 0 && !isspace((unsigned char)*p))
+        p++;
+    if (*p != 0)
+        *p++ = 0;
+    while (isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+static BOOLEAN parseEvent(char *line, fscReplayEvent_t *event)
+{
+    char *p, *name, *end;
+    int i;
+
+    event->time = strtod(line, &end);
+    if (end == line || event->time < 0 || !isspace((unsigned char)*end))
+        return FALSE;
+
+    for (p = end; isspace((unsigned char)*p); p++)
+        ;
+    name = p;
+    p = nextWord(p);
+
+    for (i = 0; i < NUM_REPLAY_ACTIONS; i++) {
+        if (strcmp(name, replayActions[i].name) == 0)
+            break;
+    }
+    if (i == NUM_REPLAY_ACTIONS)
+        return FALSE;
+
+    event->action = replayActions[i].action;
+    if ((event->arg = strdup(p)) == NULL)
+        return FALSE;
+    event->arg2 = replayActions[i].bText ? event->arg + strlen(event->arg) : nextWord(event->arg);
+
+    if (event->action == FSC_REPLAY_EXPECT && strcmp(event->arg, "valid") != 0 && strcmp(event->arg, "invalid") != 0)
+        return FALSE;
+
+    return (replayActions[i].minArgs < 1 || event->arg[0] != 0) &&
+           (replayActions[i].minArgs < 2 || event->arg2[0] != 0);
+}
+
+/*
+ * Load a trace to replay, returns -1 if it cannot be read or has a bad line
+ */
+int fscReplaySetTrace(const char *file)
+{
+    char line[FSC_REPLAY_LINE_LEN];
+    fscReplayEvent_t *grown;
+    FILE *fp;
+    int lineNo = 0;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[strspn(line, " \t")] == 0 || line[strspn(line, " \t")] == '#')
+            continue;
+
+        if (numEvents == maxEvents) {
+            if ((grown = realloc(events, (size_t)(maxEvents ? maxEvents * 2 : 64) * sizeof(*events))) == NULL) {
+                fprintf(stderr, "Out of memory loading %s\n", file);
+                fclose(fp);
+                return -1;
+            }
+            events = grown;
+            maxEvents = maxEvents ? maxEvents * 2 : 64;
+        }
+
+        if (!parseEvent(line, &events[numEvents]) ||
+            (numEvents > 0 && events[numEvents].time < events[numEvents - 1].time)) {
+            fprintf(stderr, "Bad event in %s line %d\n", file, lineNo);
+            fclose(fp);
+            return -1;
+        }
+
+        if (events[numEvents].action == FSC_REPLAY_EXPECT) {
+            bExpectValid = (strcmp(events[numEvents].arg, "valid") == 0);
+            expectTime = events[numEvents].time;
+        }
+        numEvents++;
+    }
+    fclose(fp);
+
+    bReplay = TRUE;
+    return 0;
+}
+
+BOOLEAN fscReplayActive(void)
+{
+    return bReplay;
+}
+
+/*
+ * Give a file the virtual time as its mtime
+ */
+static void setMtime(int fd)
+{
+    struct timespec times[2];
+
+    times[0].tv_sec = times[1].tv_sec = fscClockWallTime();
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    futimens(fd, times);
+}
+
+static void writeFile(const char *file, int flags, const char *text, BOOLEAN bLine, const char *source)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    char buf[4096];
+    ssize_t len;
+    int fd, src;
+
+    // Trace paths are under the root, so one trace serves any number of instances
+    file = fscRootPath(file, path, sizeof(path));
+
+    if ((fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Replay unable to write %s\n", file);
+        return;
+    }
+
+    if (text != NULL && text[0] != 0 &&
+        (write(fd, text, strlen(text)) < 0 || (bLine && write(fd, "\n", 1) < 0)))
+        FSC_LOG(LOG_SEV_ERROR, "Replay unable to write %s\n", file);
+
+    if (source != NULL) {
+        if ((src = open(source, O_RDONLY | O_CLOEXEC)) < 0) {
+            FSC_LOG(LOG_SEV_ERROR, "Replay unable to read %s\n", source);
+        } else {
+            while ((len = read(src, buf, sizeof(buf))) > 0 && write(fd, buf, (size_t)len) == len)
+                ;
+            close(src);
+        }
+    }
+
+    setMtime(fd);
+    close(fd);
+}
+
+static void applyEvent(const fscReplayEvent_t *event)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    BOOLEAN bKnown = TRUE;
+
+    switch (event->action) {
+    case FSC_REPLAY_CREATE:
+        writeFile(event->arg, O_TRUNC, event->arg2, TRUE, NULL);
+        break;
+    case FSC_REPLAY_APPEND:
+        writeFile(event->arg, O_APPEND, event->arg2, TRUE, NULL);
+        break;
+    case FSC_REPLAY_WRITE:
+        writeFile(event->arg, O_APPEND, event->arg2, FALSE, NULL);
+        break;
+    case FSC_REPLAY_COPY:
+        writeFile(event->arg, O_TRUNC, NULL, FALSE, event->arg2);
+        break;
+    case FSC_REPLAY_TOUCH:
+        writeFile(event->arg, 0, NULL, FALSE, NULL);
+        break;
+    case FSC_REPLAY_REMOVE:
+        unlink(fscRootPath(event->arg, path, sizeof(path)));
+        break;
+    case FSC_REPLAY_START:
+    case FSC_REPLAY_EXIT:
+        bKnown = (fscProcInject(event->arg, event->action == FSC_REPLAY_START) == 0);
+        break;
+    case FSC_REPLAY_HEARTBEAT:
+        bKnown = (fscHeartbeatInject(event->arg) == 0);
+        break;
+    case FSC_REPLAY_KMSG:
+        fscKmsgInject(event->arg);
+        break;
+    case FSC_REPLAY_HAL:
+        fscHalStubConfigure(atoi(event->arg), atoi(event->arg2));
+        break;
+    case FSC_REPLAY_RECHECK:
+        fscRequestRecheck();
+        break;
+    case FSC_REPLAY_EXPECT:
+        break;
+    }
+
+    if (!bKnown)
+        FSC_LOG(LOG_SEV_WARN, "Replay event for unknown %s ignored\n", event->arg);
+}
+
+/*
+ * Apply all events which are due and wait for the next one
+ */
+static void replayHandle(void *ctx)
+{
+    double now = fscMonotonicTime();
+
+    (void)ctx;
+
+    while (nextEvent < numEvents && startTime + events[nextEvent].time <= now)
+        applyEvent(&events[nextEvent++]);
+
+    if (nextEvent < numEvents)
+        fscLoopTimerArm(replayTimer, startTime + events[nextEvent].time - now, 0);
+}
+
+/*
+ * Start the replay, the trace times count from here. Must be called once the probes are set up.
+ */
+void fscReplayInit(void)
+{
+    if (!fscReplayActive())
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &realStart);
+    startTime = fscMonotonicTime();
+    FSC_LOG(LOG_SEV_INFO, "Replaying %d events\n", numEvents);
+
+    // Events at the very start are in place before anything is checked
+    if ((replayTimer = fscLoopTimerAdd(replayHandle, NULL)) >= 0)
+        replayHandle(NULL);
+}
+
+/*
+ * Check the verdict against the one the trace expects, returns the exit status of the replay
+ */
+int fscReplayVerdict(BOOLEAN bValidImage)
+{
+    double elapsed = fscMonotonicTime() - startTime;
+    struct timespec realEnd;
+    BOOLEAN bPassed;
+
+    clock_gettime(CLOCK_MONOTONIC, &realEnd);
+    FSC_LOG(LOG_SEV_INFO, "Replayed %d of %d events, %s verdict after %.1f seconds in %.1f ms\n",
+            nextEvent, numEvents, bValidImage ? "valid" : "invalid", elapsed,
+            (double)(realEnd.tv_sec - realStart.tv_sec) * 1000.0 + (double)(realEnd.tv_nsec - realStart.tv_nsec) / 1000000.0);
+
+    if (expectTime < 0)
+        return 0;
+
+    bPassed = (bValidImage == bExpectValid && elapsed <= expectTime);
+    FSC_LOG(bPassed ? LOG_SEV_INFO : LOG_SEV_ERROR, "Replay %s, expected a %s verdict within %.0f seconds\n",
+            bPassed ? "passed" : "failed", bExpectValid ? "valid" : "invalid", expectTime);
+
+    return bPassed ? 0 : 1;
+}
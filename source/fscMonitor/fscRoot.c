@@ -0,0 +1,89 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscRoot.c
+ * @brief Root directory of the files fscMonitor uses
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fscRoot.h"
+
+static char root[FSC_ROOT_MAX_LEN + 1];
+static int bRootSet = 0;
+
+/*
+ * Move the root, a NULL or empty dir keeps the current one. Fails if dir is too long.
+ */
+int fscRootSet(const char *dir)
+{
+    size_t len;
+
+    if (dir == NULL || dir[0] == 0)
+        return 0;
+
+    len = strlen(dir);
+    while (len > 1 && dir[len - 1] == '/')
+        len--;
+    if (len > FSC_ROOT_MAX_LEN)
+        return -1;
+
+    // A root of / is the same as none
+    if (len == 1 && dir[0] == '/')
+        len = 0;
+
+    memcpy(root, dir, len);
+    root[len] = 0;
+    bRootSet = 1;
+    return 0;
+}
+
+static void rootInit(void)
+{
+    // Clients which never set the root follow the environment, a bad one is ignored
+    if (!bRootSet) {
+        bRootSet = 1;
+        fscRootSet(getenv(FSC_ROOT_ENV));
+    }
+}
+
+/*
+ * Returns the root directory, empty when it is /
+ */
+const char *fscRootDir(void)
+{
+    rootInit();
+    return root;
+}
+
+/*
+ * Returns path under the root, which is either path itself or written to buf
+ */
+const char *fscRootPath(const char *path, char *buf, size_t len)
+{
+    rootInit();
+
+    if (root[0] == 0)
+        return path;
+
+    snprintf(buf, len, "%s%s", root, path);
+    return buf;
+}
@@ -0,0 +1,55 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscRoot.h
+ * @brief Root directory of the files fscMonitor uses
+ *
+ * Every fixed path, e.g. /nvram/forceFSC, /tmp/response.txt or FSC_STATUS_FILE, is taken relative
+ * to a root directory. It is / on a device, and can be moved with fscMonitor --root or the FSC_ROOT
+ * environment variable so that tests run many instances side by side in private directories
+ * without needing root. The client library and fscctl pick it up from the environment as well.
+ * Kernel interfaces under /proc, /sys and /dev/kmsg are not moved.
+ */
+
+#ifndef FSC_ROOT_H
+#define FSC_ROOT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FSC_ROOT_ENV "FSC_ROOT"
+
+// Short enough that every path still fits a unix socket address
+#define FSC_ROOT_MAX_LEN 64
+
+// Size of a buffer holding any of the fixed paths under the root
+#define FSC_ROOT_PATH_LEN 256
+
+int fscRootSet(const char *dir);
+const char *fscRootDir(void);
+const char *fscRootPath(const char *path, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSC_ROOT_H */
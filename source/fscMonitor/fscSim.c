@@ -0,0 +1,538 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscSim.c
+ * @brief Fleet simulator
+ *
+ * Runs the timeout policy of the check (fscPolicy.c) for many virtual gateways at once, to see
+ * how a policy trades verdict latency against false rollbacks over a fleet. Each gateway draws its
+ * boot time, XConf delay and failure behaviour from the configured distributions, and its samples
+ * are run on a discrete-event scheduler. Gateways are sharded over threads, each shard with its
+ * own scheduler; every gateway has its own random stream, so the results do not depend on the
+ * number of threads.
+ *
+ * A gateway models the parts of the check which drive the verdict:
+ *  - the stack comes up in stages (psm, pam, wifi), each of which is progress
+ *  - a good image gets an XConf response some time after the stack is up, unless XConf is lost
+ *  - a bad image gets stuck early, may show a fatal signal and rarely still gets a response
+ *  - fatal signals are acted upon right away when fast fail is on, as the pidfd probe does
+ *
+ * Times are lognormal, given as median:sigma in seconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "fscMonitor.h"
+
+#define FSC_SIM_MAX_THREADS 256
+#define FSC_SIM_STAGES 3
+#define FSC_SIM_NEVER 1e30
+#define FSC_SIM_HISTOGRAM_SIZE (4 * 3600)   // one second buckets
+
+typedef struct {
+    double median;
+    double sigma;
+} fscSimDist_t;
+
+typedef struct {
+    long instances;
+    int threads;
+    unsigned long long seed;
+    BOOLEAN bFastFail;
+    fscSimDist_t boot;          // until the stack is up
+    fscSimDist_t xconf;         // from the stack being up to the response
+    fscSimDist_t fatal;         // until a bad image shows a fatal signal
+    double xconfLoss;           // good image never gets a response
+    double badRate;
+    double badFatal;            // bad image shows a fatal signal
+    double badXconf;            // bad image still gets a response
+} fscSimParams_t;
+
+typedef enum {
+    FSC_SIM_VALID_GOOD,
+    FSC_SIM_INVALID_GOOD,       // false rollback
+    FSC_SIM_INVALID_BAD,
+    FSC_SIM_VALID_BAD,          // bad image let through
+    FSC_SIM_NUM_OUTCOMES
+} eFscSimOutcome;
+
+static const char *outcomeNames[FSC_SIM_NUM_OUTCOMES] = {
+    "good, valid", "good, rolled back", "bad, rolled back", "bad, valid"
+};
+
+typedef struct {
+    fscPolicy_t policy;
+    double stages[FSC_SIM_STAGES];
+    double xconfTime;
+    double fatalTime;
+    double lastSample;
+    double nextSample;
+    uint32_t samples;
+    uint16_t halCalls;
+    uint8_t bBad;
+    uint8_t bDone;
+} fscSimInstance_t;
+
+typedef struct {
+    double time;
+    uint32_t instance;
+} fscSimEvent_t;
+
+typedef struct {
+    long first;
+    long count;
+    fscSimInstance_t *instances;
+    fscSimEvent_t *heap;
+    long heapLen;
+    uint64_t events;
+    uint64_t samples;
+    uint64_t halCalls;
+    uint32_t outcomes[FSC_SIM_NUM_OUTCOMES];
+    uint32_t *histograms;       // FSC_SIM_NUM_OUTCOMES x FSC_SIM_HISTOGRAM_SIZE
+} fscSimShard_t;
+
+static fscSimParams_t params;
+static fscPolicyConfig_t policyConfig;
+
+/*
+ * splitmix64, one stream per gateway
+ */
+static uint64_t randNext(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double randUniform(uint64_t *state)
+{
+    return (double)(randNext(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double randLognormal(uint64_t *state, const fscSimDist_t *dist)
+{
+    double u1 = randUniform(state), u2 = randUniform(state);
+
+    if (u1 < 1e-300)
+        u1 = 1e-300;
+    return dist->median * exp(dist->sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+static void heapPush(fscSimShard_t *shard, double time, uint32_t instance)
+{
+    fscSimEvent_t *heap = shard->heap;
+    long i = shard->heapLen++, parent;
+
+    while (i > 0 && heap[parent = (i - 1) / 2].time > time) {
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i].time = time;
+    heap[i].instance = instance;
+}
+
+static fscSimEvent_t heapPop(fscSimShard_t *shard)
+{
+    fscSimEvent_t *heap = shard->heap;
+    fscSimEvent_t top = heap[0], last = heap[--shard->heapLen];
+    long i = 0, child;
+
+    while ((child = 2 * i + 1) < shard->heapLen) {
+        if (child + 1 < shard->heapLen && heap[child + 1].time < heap[child].time)
+            child++;
+        if (heap[child].time >= last.time)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    return top;
+}
+
+static void instanceInit(fscSimShard_t *shard, long idx)
+{
+    fscSimInstance_t *inst = &shard->instances[idx];
+    uint64_t rng = params.seed + (uint64_t)(shard->first + idx) * 0x632be59bd9b4e019ULL;
+    double boot;
+    int i;
+
+    memset(inst, 0, sizeof(*inst));
+    inst->bBad = randUniform(&rng) < params.badRate;
+    boot = randLognormal(&rng, &params.boot);
+
+    for (i = 0; i < FSC_SIM_STAGES; i++)
+        inst->stages[i] = boot * (i + 1) / FSC_SIM_STAGES;
+
+    inst->xconfTime = FSC_SIM_NEVER;
+    inst->fatalTime = FSC_SIM_NEVER;
+    if (!inst->bBad) {
+        if (randUniform(&rng) >= params.xconfLoss)
+            inst->xconfTime = boot + randLognormal(&rng, &params.xconf);
+    } else {
+        // A bad image gets stuck after the first stage
+        for (i = 1; i < FSC_SIM_STAGES; i++)
+            inst->stages[i] = FSC_SIM_NEVER;
+        if (randUniform(&rng) < params.badFatal)
+            inst->fatalTime = randLognormal(&rng, &params.fatal);
+        if (randUniform(&rng) < params.badXconf)
+            inst->xconfTime = boot + randLognormal(&rng, &params.xconf);
+    }
+
+    fscPolicyInit(&inst->policy, &policyConfig);
+    inst->halCalls = 1;
+    inst->nextSample = policyConfig.sampleInterval;
+    heapPush(shard, inst->nextSample, (uint32_t)idx);
+
+    // The fatal probes wake the check up right away
+    if (params.bFastFail && inst->fatalTime < FSC_SIM_NEVER)
+        heapPush(shard, inst->fatalTime, (uint32_t)idx);
+}
+
+static void verdict(fscSimShard_t *shard, fscSimInstance_t *inst, BOOLEAN bValid, double elapsed)
+{
+    eFscSimOutcome outcome;
+    long bucket = (long)elapsed;
+
+    if (inst->bBad)
+        outcome = bValid ? FSC_SIM_VALID_BAD : FSC_SIM_INVALID_BAD;
+    else
+        outcome = bValid ? FSC_SIM_VALID_GOOD : FSC_SIM_INVALID_GOOD;
+
+    if (bucket >= FSC_SIM_HISTOGRAM_SIZE)
+        bucket = FSC_SIM_HISTOGRAM_SIZE - 1;
+
+    inst->bDone = TRUE;
+    inst->halCalls++;
+    shard->outcomes[outcome]++;
+    shard->histograms[outcome * FSC_SIM_HISTOGRAM_SIZE + bucket]++;
+    shard->samples += inst->samples;
+    shard->halCalls += inst->halCalls;
+}
+
+/*
+ * One sample of the check, the same steps as the main loop takes
+ */
+static void sample(fscSimShard_t *shard, uint32_t idx, double elapsed)
+{
+    fscSimInstance_t *inst = &shard->instances[idx];
+    int i;
+
+    inst->samples++;
+
+    if (params.bFastFail && inst->fatalTime <= elapsed) {
+        verdict(shard, inst, FALSE, elapsed);
+        return;
+    }
+
+    if (inst->xconfTime <= elapsed) {
+        verdict(shard, inst, TRUE, elapsed);
+        return;
+    }
+
+    for (i = 0; i < FSC_SIM_STAGES; i++) {
+        if (inst->stages[i] > inst->lastSample && inst->stages[i] <= elapsed) {
+            if (fscPolicyProgress(&inst->policy, elapsed) > 0)
+                inst->halCalls++;
+            break;
+        }
+    }
+    inst->lastSample = elapsed;
+
+    if (fscPolicyExpired(&inst->policy, elapsed)) {
+        verdict(shard, inst, FALSE, elapsed);
+        return;
+    }
+
+    inst->nextSample = elapsed + policyConfig.sampleInterval;
+    heapPush(shard, inst->nextSample, idx);
+}
+
+static void *shardMain(void *arg)
+{
+    fscSimShard_t *shard = (fscSimShard_t *)arg;
+    fscSimInstance_t *inst;
+    fscSimEvent_t ev;
+    long i;
+
+    for (i = 0; i < shard->count; i++)
+        instanceInit(shard, i);
+
+    while (shard->heapLen > 0) {
+        ev = heapPop(shard);
+        shard->events++;
+        inst = &shard->instances[ev.instance];
+        if (inst->bDone)
+            continue;
+
+        // A fatal signal takes a sample right away, the sample it preempts is dropped
+        if (ev.time != inst->nextSample && ev.time != inst->fatalTime)
+            continue;
+        sample(shard, ev.instance, ev.time);
+    }
+
+    return NULL;
+}
+
+/*
+ * Time by which the given fraction of the verdicts in a histogram were delivered
+ */
+static long percentile(const uint64_t *histogram, uint64_t total, double fraction)
+{
+    uint64_t target = (uint64_t)ceil(fraction * (double)total), seen = 0;
+    long i;
+
+    for (i = 0; i < FSC_SIM_HISTOGRAM_SIZE; i++) {
+        if ((seen += histogram[i]) >= target && seen > 0)
+            return i;
+    }
+
+    return FSC_SIM_HISTOGRAM_SIZE - 1;
+}
+
+static int parseDist(const char *arg, fscSimDist_t *dist)
+{
+    if (sscanf(arg, "%lf:%lf", &dist->median, &dist->sigma) != 2 || dist->median <= 0 || dist->sigma < 0) {
+        fprintf(stderr, "Invalid distribution %s, expected median:sigma\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+static int parseRate(const char *arg, double *rate)
+{
+    char *end;
+
+    *rate = strtod(arg, &end);
+    if (*end != 0 || *rate < 0 || *rate > 1) {
+        fprintf(stderr, "Invalid rate %s, expected 0 to 1\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n|--instances <count>] [-j|--threads <count>] [--seed <n>]\n"
+                    "       [-p|--progressive] [--interval <s>] [--timeout <s>] [--initial-timeout <s>]\n"
+                    "       [--extend <s>] [--no-fast-fail] [--boot <median:sigma>] [--xconf <median:sigma>]\n"
+                    "       [--fatal <median:sigma>] [--xconf-loss <rate>] [--bad-rate <rate>]\n"
+                    "       [--bad-fatal <rate>] [--bad-xconf <rate>]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    static fscSimShard_t shards[FSC_SIM_MAX_THREADS];
+    static uint64_t histograms[FSC_SIM_NUM_OUTCOMES][FSC_SIM_HISTOGRAM_SIZE];
+    pthread_t threads[FSC_SIM_MAX_THREADS];
+    struct timespec t1, t2;
+    struct rusage usage1, usage2;
+    uint64_t outcomes[FSC_SIM_NUM_OUTCOMES] = {0};
+    uint64_t events = 0, samples = 0, halCalls = 0, total;
+    double wall, cpu;
+    long perShard, first = 0;
+    int opt, i, j, k;
+
+    static const struct option longOptions[] = {
+        { "instances",       required_argument, NULL, 'n' },
+        { "threads",         required_argument, NULL, 'j' },
+        { "seed",            required_argument, NULL, 'S' },
+        { "progressive",     no_argument,       NULL, 'p' },
+        { "interval",        required_argument, NULL, 'i' },
+        { "timeout",         required_argument, NULL, 'T' },
+        { "initial-timeout", required_argument, NULL, 'I' },
+        { "extend",          required_argument, NULL, 'E' },
+        { "no-fast-fail",    no_argument,       NULL, 'N' },
+        { "boot",            required_argument, NULL, 'b' },
+        { "xconf",           required_argument, NULL, 'x' },
+        { "fatal",           required_argument, NULL, 'f' },
+        { "xconf-loss",      required_argument, NULL, 'l' },
+        { "bad-rate",        required_argument, NULL, 'r' },
+        { "bad-fatal",       required_argument, NULL, 'F' },
+        { "bad-xconf",       required_argument, NULL, 'X' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    fscPolicyDefaults(&policyConfig);
+    params.instances = 100000;
+    params.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    params.seed = 1;
+    params.bFastFail = TRUE;
+    params.boot = (fscSimDist_t){ 180, 0.3 };
+    params.xconf = (fscSimDist_t){ 60, 1.2 };
+    params.fatal = (fscSimDist_t){ 300, 0.8 };
+    params.xconfLoss = 0.01;
+    params.badRate = 0.01;
+    params.badFatal = 0.7;
+    params.badXconf = 0.05;
+
+    while ((opt = getopt_long(argc, argv, "n:j:p", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            params.instances = atol(optarg);
+            break;
+        case 'j':
+            params.threads = atoi(optarg);
+            break;
+        case 'S':
+            params.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            policyConfig.bProgressive = TRUE;
+            break;
+        case 'i':
+            policyConfig.sampleInterval = atoi(optarg);
+            break;
+        case 'T':
+            policyConfig.maxTimeout = atoi(optarg);
+            break;
+        case 'I':
+            policyConfig.initialTimeout = atoi(optarg);
+            break;
+        case 'E':
+            policyConfig.extendValue = atoi(optarg);
+            break;
+        case 'N':
+            params.bFastFail = FALSE;
+            break;
+        case 'b':
+            if (parseDist(optarg, &params.boot) != 0)
+                return 1;
+            break;
+        case 'x':
+            if (parseDist(optarg, &params.xconf) != 0)
+                return 1;
+            break;
+        case 'f':
+            if (parseDist(optarg, &params.fatal) != 0)
+                return 1;
+            break;
+        case 'l':
+            if (parseRate(optarg, &params.xconfLoss) != 0)
+                return 1;
+            break;
+        case 'r':
+            if (parseRate(optarg, &params.badRate) != 0)
+                return 1;
+            break;
+        case 'F':
+            if (parseRate(optarg, &params.badFatal) != 0)
+                return 1;
+            break;
+        case 'X':
+            if (parseRate(optarg, &params.badXconf) != 0)
+                return 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.instances <= 0 || params.instances > UINT32_MAX || policyConfig.sampleInterval <= 0 ||
+        policyConfig.maxTimeout <= policyConfig.timeOffset || policyConfig.initialTimeout <= policyConfig.timeOffset) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (params.threads < 1)
+        params.threads = 1;
+    if (params.threads > FSC_SIM_MAX_THREADS)
+        params.threads = FSC_SIM_MAX_THREADS;
+    if (params.threads > params.instances)
+        params.threads = (int)params.instances;
+
+    // Shards are set up by their own thread, so their memory is local to the core running them
+    perShard = (params.instances + params.threads - 1) / params.threads;
+    for (i = 0; i < params.threads; i++) {
+        shards[i].first = first;
+        shards[i].count = (params.instances - first < perShard) ? params.instances - first : perShard;
+        first += shards[i].count;
+        shards[i].instances = malloc((size_t)shards[i].count * sizeof(fscSimInstance_t));
+        shards[i].heap = malloc((size_t)shards[i].count * 2 * sizeof(fscSimEvent_t));
+        shards[i].histograms = calloc(FSC_SIM_NUM_OUTCOMES * FSC_SIM_HISTOGRAM_SIZE, sizeof(uint32_t));
+        if (shards[i].instances == NULL || shards[i].heap == NULL || shards[i].histograms == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    getrusage(RUSAGE_SELF, &usage1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (i = 0; i < params.threads; i++) {
+        if (pthread_create(&threads[i], NULL, shardMain, &shards[i]) != 0) {
+            fprintf(stderr, "Error starting thread %d\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < params.threads; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    getrusage(RUSAGE_SELF, &usage2);
+
+    for (i = 0; i < params.threads; i++) {
+        events += shards[i].events;
+        samples += shards[i].samples;
+        halCalls += shards[i].halCalls;
+        for (j = 0; j < FSC_SIM_NUM_OUTCOMES; j++) {
+            outcomes[j] += shards[i].outcomes[j];
+            for (k = 0; k < FSC_SIM_HISTOGRAM_SIZE; k++)
+                histograms[j][k] += shards[i].histograms[j * FSC_SIM_HISTOGRAM_SIZE + k];
+        }
+    }
+
+    wall = (double)(t2.tv_sec - t1.tv_sec) + (double)(t2.tv_nsec - t1.tv_nsec) / 1e9;
+    cpu = (double)(usage2.ru_utime.tv_sec - usage1.ru_utime.tv_sec + usage2.ru_stime.tv_sec - usage1.ru_stime.tv_sec) +
+          (double)(usage2.ru_utime.tv_usec - usage1.ru_utime.tv_usec + usage2.ru_stime.tv_usec - usage1.ru_stime.tv_usec) / 1e6;
+
+    printf("policy:     %s, interval %d s, timeout %d s", policyConfig.bProgressive ? "progressive" : "fixed",
+           policyConfig.sampleInterval, policyConfig.maxTimeout);
+    if (policyConfig.bProgressive)
+        printf(", initial %d s, extend %d s", policyConfig.initialTimeout, policyConfig.extendValue);
+    printf(", fast fail %s\n", params.bFastFail ? "on" : "off");
+    printf("fleet:      %ld gateways, %.2f%% bad, boot %g:%g, xconf %g:%g, %.2f%% xconf lost\n",
+           params.instances, params.badRate * 100, params.boot.median, params.boot.sigma,
+           params.xconf.median, params.xconf.sigma, params.xconfLoss * 100);
+    printf("\n%-18s %10s %8s %8s %8s %8s %8s\n", "outcome", "count", "rate", "p50", "p90", "p99", "max");
+    for (j = 0; j < FSC_SIM_NUM_OUTCOMES; j++) {
+        total = outcomes[j];
+        printf("%-18s %10llu %7.3f%%", outcomeNames[j], (unsigned long long)total, 100.0 * (double)total / (double)params.instances);
+        if (total > 0)
+            printf(" %7lds %7lds %7lds %7lds", percentile(histograms[j], total, 0.5), percentile(histograms[j], total, 0.9),
+                   percentile(histograms[j], total, 0.99), percentile(histograms[j], total, 1.0));
+        printf("\n");
+    }
+
+    printf("\ncheck cost: %.1f samples and %.2f hal calls per gateway\n",
+           (double)samples / (double)params.instances, (double)halCalls / (double)params.instances);
+    printf("simulator:  %d threads, %llu events in %.3f s (%.1f M events/s), %.3f s cpu, %zu bytes per gateway\n",
+           params.threads, (unsigned long long)events, wall, (double)events / wall / 1e6, cpu,
+           sizeof(fscSimInstance_t) + 2 * sizeof(fscSimEvent_t));
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscStatus.c
+ * @brief Writer side of the fscMonitor status page
+ *
+ * Only the main thread updates the page. Updates are bracketed by fscStatusBeginUpdate() and
+ * fscStatusEndUpdate() which bump the sequence lock around the field writes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "fscMonitor.h"
+
+static fscStatusPage_t *statusPage = NULL;
+
+// Used in place of the page if it could not be created, so callers never need to check
+static fscStatus_t localStatus;
+
+/*
+ * Create and map the status page
+ */
+void fscStatusInit(void)
+{
+    fscStatus_t *status;
+    char path[FSC_ROOT_PATH_LEN];
+    const char *file = fscRootPath(FSC_STATUS_FILE, path, sizeof(path));
+    void *addr;
+    int fd;
+
+    if ((fd = open(file, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error creating %s \n", file);
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(fscStatusPage_t)) != 0) {
+        FSC_LOG(LOG_SEV_ERROR, "Error sizing %s \n", file);
+        close(fd);
+        return;
+    }
+
+    addr = mmap(NULL, sizeof(fscStatusPage_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        FSC_LOG(LOG_SEV_ERROR, "Error mapping %s \n", file);
+        return;
+    }
+    statusPage = (fscStatusPage_t *)addr;
+
+    // A previous instance may have left its page behind, reset it under the lock
+    status = fscStatusBeginUpdate();
+    memset(status, 0, sizeof(*status));
+    status->pid = (uint32_t)getpid();
+    status->phase = FSC_PHASE_STARTING;
+    status->verdict = FSC_VERDICT_PENDING;
+    statusPage->magic = FSC_STATUS_MAGIC;
+    statusPage->version = FSC_STATUS_VERSION;
+    statusPage->size = sizeof(fscStatus_t);
+    fscStatusEndUpdate();
+}
+
+/*
+ * Start an update, the returned status may be modified until fscStatusEndUpdate()
+ */
+fscStatus_t *fscStatusBeginUpdate(void)
+{
+    if (statusPage == NULL)
+        return &localStatus;
+
+    __atomic_store_n(&statusPage->sequence, statusPage->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return &statusPage->status;
+}
+
+/*
+ * Publish the update to readers
+ */
+void fscStatusEndUpdate(void)
+{
+    if (statusPage == NULL)
+        return;
+
+    __atomic_store_n(&statusPage->sequence, statusPage->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Current status as last published, only to be used from the main thread
+ */
+const fscStatus_t *fscStatusCurrent(void)
+{
+    return (statusPage == NULL) ? &localStatus : &statusPage->status;
+}
@@ -0,0 +1,131 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscStatus.h
+ * @brief Firmware Sanity Checker status page
+ *
+ * fscMonitor publishes its state in a small shared memory page. The page is protected by a
+ * sequence lock: the writer makes the sequence odd while it updates the page, so readers can take
+ * a consistent snapshot without any syscall and without ever blocking the writer. The page stays
+ * in place after fscMonitor exits so the final verdict can still be read.
+ *
+ * Readers should link libfscstatus and use fscStatusOpen()/fscStatusRead()/fscStatusClose().
+ */
+
+#ifndef FSC_STATUS_H
+#define FSC_STATUS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FSC_STATUS_FILE "/dev/shm/fscStatus"
+#define FSC_STATUS_MAGIC 0x46534353 /* "FSCS" */
+#define FSC_STATUS_VERSION 6
+
+typedef enum {
+    FSC_PHASE_STARTING,
+    FSC_PHASE_CHECKING,
+    FSC_PHASE_DONE
+} eFscPhase;
+
+typedef enum {
+    FSC_VERDICT_PENDING,
+    FSC_VERDICT_VALID,
+    FSC_VERDICT_INVALID
+} eFscVerdict;
+
+typedef enum {
+    FSC_XCONF_NONE,             // no response yet
+    FSC_XCONF_VALID,            // response names a firmware image
+    FSC_XCONF_UNKNOWN_DEVICE,   // server does not know the device
+    FSC_XCONF_ERROR,            // server error or no firmware named
+    FSC_XCONF_PARTIAL           // response is still being written
+} eFscXconfResult;
+
+// Result bits of the last sample
+#define FSC_PROBE_XCONF_VALID   (1 << 0)
+#define FSC_PROBE_PROGRESS      (1 << 1)
+#define FSC_PROBE_FATAL         (1 << 2)
+#define FSC_PROBE_COMPONENTS    (1 << 3)
+#define FSC_PROBE_PROCESSES     (1 << 4)
+#define FSC_PROBE_WAN_READY     (1 << 5)
+#define FSC_PROBE_PRESSURE      (1 << 6)
+#define FSC_PROBE_BOOT_REGRESSION (1 << 7)
+
+// Configuration flags
+#define FSC_FLAG_PRODUCTION     (1 << 0)
+#define FSC_FLAG_DEBUG_OVERRIDE (1 << 1)
+#define FSC_FLAG_PROGRESSIVE    (1 << 2)
+#define FSC_FLAG_FAST_FAIL      (1 << 3)
+#define FSC_FLAG_GUARD          (1 << 4)
+
+typedef struct {
+    uint32_t pid;
+    uint32_t phase;             // eFscPhase
+    uint32_t verdict;           // eFscVerdict
+    uint32_t flags;             // FSC_FLAG_*
+    uint32_t elapsed;           // seconds since the check started
+    uint32_t remaining;         // seconds until the check expires
+    uint32_t halTimeout;        // last timeout handed to the hal
+    uint32_t samples;           // number of samples taken
+    uint32_t probes;            // FSC_PROBE_* results of the last sample
+    uint32_t components;        // bitmap of components which sent a heartbeat
+    uint32_t restarts;          // critical process restarts seen during the check
+    uint32_t memoryStallMs;     // memory pressure stall time during the check
+    uint32_t cpuStallMs;        // cpu pressure stall time during the check
+    uint32_t kernelOopses;      // oopses and panics in the kernel log
+    uint32_t oomKills;          // OOM kills in the kernel log
+    uint32_t xconfResult;       // eFscXconfResult of the last sample
+    char reason[128];           // why the verdict was reached
+} fscStatus_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    volatile uint32_t sequence; // odd while an update is in progress
+    uint32_t size;              // sizeof(fscStatus_t) of the writer
+    fscStatus_t status;
+} fscStatusPage_t;
+
+typedef struct {
+    int fd;
+    const fscStatusPage_t *page;
+} fscStatusReader_t;
+
+/*
+ * Map the status page read-only, returns 0 on success or -1 if fscMonitor has not created it
+ */
+int fscStatusOpen(fscStatusReader_t *reader);
+
+/*
+ * Take a consistent snapshot of the status, returns 0 on success or -1 if no consistent snapshot
+ * could be taken
+ */
+int fscStatusRead(const fscStatusReader_t *reader, fscStatus_t *status);
+
+void fscStatusClose(fscStatusReader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSC_STATUS_H */
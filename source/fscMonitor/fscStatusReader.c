@@ -0,0 +1,93 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscStatusReader.c
+ * @brief Reader side of the fscMonitor status page
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "fscStatus.h"
+#include "fscRoot.h"
+
+// A writer update only takes a few hundred nanoseconds, so this is plenty
+#define FSC_STATUS_READ_RETRIES 1000
+
+int fscStatusOpen(fscStatusReader_t *reader)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    void *addr;
+
+    reader->fd = -1;
+    reader->page = NULL;
+
+    if ((reader->fd = open(fscRootPath(FSC_STATUS_FILE, path, sizeof(path)), O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+
+    addr = mmap(NULL, sizeof(fscStatusPage_t), PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (addr == MAP_FAILED) {
+        close(reader->fd);
+        reader->fd = -1;
+        return -1;
+    }
+
+    reader->page = (const fscStatusPage_t *)addr;
+    return 0;
+}
+
+int fscStatusRead(const fscStatusReader_t *reader, fscStatus_t *status)
+{
+    const fscStatusPage_t *page = reader->page;
+    uint32_t seq1, seq2;
+    int i;
+
+    if (page == NULL || page->magic != FSC_STATUS_MAGIC || page->version != FSC_STATUS_VERSION)
+        return -1;
+
+    for (i = 0; i < FSC_STATUS_READ_RETRIES; i++) {
+        seq1 = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (seq1 & 1)
+            continue;
+
+        memcpy(status, (const void *)&page->status, sizeof(*status));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+        if (seq1 == seq2) {
+            status->reason[sizeof(status->reason) - 1] = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void fscStatusClose(fscStatusReader_t *reader)
+{
+    if (reader->page != NULL)
+        munmap((void *)reader->page, sizeof(fscStatusPage_t));
+    if (reader->fd >= 0)
+        close(reader->fd);
+
+    reader->fd = -1;
+    reader->page = NULL;
+}
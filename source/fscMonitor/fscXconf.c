@@ -0,0 +1,540 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscXconf.c
+ * @brief XConf response classifier
+ *
+ * Classifies the XConf response in a single pass over the file with the multi-pattern matcher,
+ * instead of a grep pipeline per poll. The firmwareFilename key, the not-found and error markers
+ * and any configured sentinels are all found in the same scan, and the firmware name is picked out
+ * right after its key. The response can be fed in pieces, so it never has to be held in memory as
+ * a whole.
+ *
+ * Some xconf clients store the response chunk framed, gzip or zlib compressed, or both. The file
+ * is decoded as a stream: chunk framing is stripped as it is read and compressed data is inflated
+ * through a small fixed window straight into the parser, so memory use does not depend on the size
+ * of the response.
+ *
+ * The response is:
+ *  - valid when it names a firmware image, whatever else it holds, as the grep pipeline had it
+ *  - unknown-device when the server does not know us (404)
+ *  - error when the server or something in between reported an error, or no firmware was named
+ *  - partial when it is still being written
+ *
+ * The not-found and error markers only decide the result when no firmware was named, so e.g. an
+ * "error" field next to a firmwareFilename does not fail a good response.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "fscMonitor.h"
+
+#define FSC_XCONF_SENTINEL_LEN 64
+#define FSC_XCONF_WINDOW 4096
+
+// Decoded bytes we are willing to look at, anything past that cannot be a sane response
+#define FSC_XCONF_MAX_RESPONSE (4 * 1024 * 1024)
+
+// Chunk framing states
+#define FSC_XCONF_CHUNK_SIZE 0
+#define FSC_XCONF_CHUNK_EXT 1
+#define FSC_XCONF_CHUNK_DATA 2
+#define FSC_XCONF_CHUNK_DATA_END 3
+#define FSC_XCONF_CHUNK_TRAILER 4
+#define FSC_XCONF_CHUNK_DONE 5
+
+// Body encodings
+#define FSC_XCONF_BODY_UNKNOWN 0
+#define FSC_XCONF_BODY_PLAIN 1
+#define FSC_XCONF_BODY_DEFLATED 2
+
+// Pattern classes
+#define FSC_XCONF_KEY 0
+#define FSC_XCONF_NOT_FOUND 1
+#define FSC_XCONF_FAILURE 2
+
+// Value parser states after the firmwareFilename key
+#define FSC_XCONF_VALUE_NONE 0
+#define FSC_XCONF_VALUE_COLON 1
+#define FSC_XCONF_VALUE_QUOTE 2
+#define FSC_XCONF_VALUE_STRING 3
+#define FSC_XCONF_VALUE_DONE 4
+
+static const struct {
+    const char *pattern;
+    int class;
+} defaultPatterns[] = {
+    { "\"firmwareFilename\"",       FSC_XCONF_KEY },
+    { "404 NOT FOUND",              FSC_XCONF_NOT_FOUND },
+    { "\"statusCode\":404",         FSC_XCONF_NOT_FOUND },
+    { "\"status\":404",             FSC_XCONF_NOT_FOUND },
+    { "Internal Server Error",      FSC_XCONF_FAILURE },
+    { "Service Unavailable",        FSC_XCONF_FAILURE },
+    { "Bad Request",                FSC_XCONF_FAILURE },
+    { "\"error\"",                  FSC_XCONF_FAILURE },
+    { "<html",                      FSC_XCONF_FAILURE },
+};
+
+#define FSC_XCONF_NUM_DEFAULT (int)(sizeof(defaultPatterns) / sizeof(defaultPatterns[0]))
+
+static char sentinels[FSC_MATCH_MAX_PATTERNS][FSC_XCONF_SENTINEL_LEN];
+static int sentinelClass[FSC_MATCH_MAX_PATTERNS];
+static int numSentinels = 0;
+static uint32_t classMask[3];
+static fscMatcher_t *matcher = NULL;
+
+static const char *resultNames[] = { "none", "valid", "unknown-device", "error", "partial" };
+
+/*
+ * Additional sentinels from a file, one "unknown <string>" or "error <string>" per line
+ */
+int fscXconfSetSentinels(const char *file)
+{
+    char line[FSC_XCONF_SENTINEL_LEN + 16];
+    char *string;
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return -1;
+    }
+
+    numSentinels = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0 || line[0] == '#')
+            continue;
+
+        if ((string = strchr(line, ' ')) == NULL || string[1] == 0 ||
+            numSentinels == FSC_MATCH_MAX_PATTERNS - FSC_XCONF_NUM_DEFAULT) {
+            fprintf(stderr, "Invalid or too many sentinels in %s\n", file);
+            fclose(fp);
+            return -1;
+        }
+        *string++ = 0;
+
+        if (strcmp(line, "unknown") == 0) {
+            sentinelClass[numSentinels] = FSC_XCONF_NOT_FOUND;
+        } else if (strcmp(line, "error") == 0) {
+            sentinelClass[numSentinels] = FSC_XCONF_FAILURE;
+        } else {
+            fprintf(stderr, "Unknown sentinel class %s in %s\n", line, file);
+            fclose(fp);
+            return -1;
+        }
+        snprintf(sentinels[numSentinels++], FSC_XCONF_SENTINEL_LEN, "%s", string);
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+/*
+ * Compile the patterns the first time they are needed
+ */
+static BOOLEAN compilePatterns(void)
+{
+    const char *list[FSC_MATCH_MAX_PATTERNS];
+    int i;
+
+    if (matcher != NULL)
+        return TRUE;
+
+    for (i = 0; i < FSC_XCONF_NUM_DEFAULT; i++) {
+        list[i] = defaultPatterns[i].pattern;
+        classMask[defaultPatterns[i].class] |= 1u << i;
+    }
+    for (i = 0; i < numSentinels; i++) {
+        list[FSC_XCONF_NUM_DEFAULT + i] = sentinels[i];
+        classMask[sentinelClass[i]] |= 1u << (FSC_XCONF_NUM_DEFAULT + i);
+    }
+
+    if ((matcher = fscMatchCompile(list, FSC_XCONF_NUM_DEFAULT + numSentinels, FSC_MATCH_NOCASE)) == NULL) {
+        FSC_LOG(LOG_SEV_ERROR, "Error compiling the xconf patterns\n");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Pick the firmware name out of the bytes following the key, returns how many bytes were used
+ */
+static size_t parseValue(fscXconfParser_t *p, const char *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len && p->valueState != FSC_XCONF_VALUE_DONE; i++) {
+        char c = buf[i];
+
+        switch (p->valueState) {
+        case FSC_XCONF_VALUE_COLON:
+            if (c == ':')
+                p->valueState = FSC_XCONF_VALUE_QUOTE;
+            else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+                p->valueState = FSC_XCONF_VALUE_DONE;
+            break;
+        case FSC_XCONF_VALUE_QUOTE:
+            if (c == '"')
+                p->valueState = FSC_XCONF_VALUE_STRING;
+            else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+                p->valueState = FSC_XCONF_VALUE_DONE;
+            break;
+        case FSC_XCONF_VALUE_STRING:
+            if (c == '"')
+                p->valueState = FSC_XCONF_VALUE_DONE;
+            else if (p->firmwareLen < sizeof(p->firmware) - 1)
+                p->firmware[p->firmwareLen++] = c;
+            break;
+        }
+    }
+
+    return i;
+}
+
+typedef struct {
+    fscXconfParser_t *parser;
+    const char *buf;
+    size_t len;
+} fscXconfChunk_t;
+
+static int keyHandle(int pattern, size_t end, void *ctx)
+{
+    fscXconfChunk_t *chunk = ctx;
+    fscXconfParser_t *p = chunk->parser;
+
+    // Only the first firmwareFilename counts
+    if (!(classMask[FSC_XCONF_KEY] & (1u << pattern)) || p->valueState != FSC_XCONF_VALUE_NONE)
+        return 0;
+
+    p->valueState = FSC_XCONF_VALUE_COLON;
+    parseValue(p, chunk->buf + end, chunk->len - end);
+    return 0;
+}
+
+void fscXconfParserInit(fscXconfParser_t *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+/*
+ * Feed the next piece of the response
+ */
+void fscXconfParserFeed(fscXconfParser_t *p, const char *buf, size_t len)
+{
+    fscXconfChunk_t chunk;
+    size_t i;
+
+    if (len == 0 || !compilePatterns())
+        return;
+
+    // A firmware name split over two pieces is finished first
+    if (p->valueState != FSC_XCONF_VALUE_NONE && p->valueState != FSC_XCONF_VALUE_DONE)
+        parseValue(p, buf, len);
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] != ' ' && buf[i] != '\t' && buf[i] != '\r' && buf[i] != '\n') {
+            if (p->first == 0)
+                p->first = buf[i];
+            break;
+        }
+    }
+    for (i = len; i > 0; i--) {
+        if (buf[i - 1] != ' ' && buf[i - 1] != '\t' && buf[i - 1] != '\r' && buf[i - 1] != '\n') {
+            p->last = buf[i - 1];
+            break;
+        }
+    }
+
+    chunk.parser = p;
+    chunk.buf = buf;
+    chunk.len = len;
+    p->seen |= fscMatchScan(matcher, &p->state, buf, len, keyHandle, &chunk);
+    p->total += len;
+}
+
+/*
+ * Classify everything fed so far, a valid response leaves the firmware name in the parser
+ */
+eFscXconfResult fscXconfParserResult(fscXconfParser_t *p)
+{
+    p->firmware[p->firmwareLen] = 0;
+
+    if (p->valueState == FSC_XCONF_VALUE_DONE && p->firmwareLen > 0)
+        return FSC_XCONF_VALID;
+    if (p->seen & classMask[FSC_XCONF_NOT_FOUND])
+        return FSC_XCONF_UNKNOWN_DEVICE;
+    if (p->seen & classMask[FSC_XCONF_FAILURE])
+        return FSC_XCONF_ERROR;
+
+    // Nothing yet, a name still being written, or a JSON document which is not closed yet
+    if (p->total == 0 || (p->valueState != FSC_XCONF_VALUE_NONE && p->valueState != FSC_XCONF_VALUE_DONE) ||
+        (p->first == '{' && p->last != '}'))
+        return FSC_XCONF_PARTIAL;
+
+    return FSC_XCONF_ERROR;
+}
+
+typedef struct {
+    fscXconfParser_t parser;
+    BOOLEAN bFramingKnown;
+    BOOLEAN bChunked;
+    int chunkState;
+    size_t chunkLeft;
+    size_t lineLen;             // length of the current trailer line
+    int body;                   // FSC_XCONF_BODY_*
+    unsigned char magic[2];     // first body bytes, held back until the encoding is known
+    size_t magicLen;
+    z_stream zs;
+    BOOLEAN bInflating;
+    BOOLEAN bStreamEnd;
+    BOOLEAN bCorrupt;
+    unsigned char window[FSC_XCONF_WINDOW];
+} fscXconfDecoder_t;
+
+static void bodyFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len);
+
+/*
+ * Hand decoded bytes to the parser
+ */
+static void parserFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len)
+{
+    if (d->parser.total + len > FSC_XCONF_MAX_RESPONSE) {
+        d->bCorrupt = TRUE;
+        return;
+    }
+    fscXconfParserFeed(&d->parser, (const char *)buf, len);
+}
+
+/*
+ * Inflate through the window into the parser
+ */
+static void inflateFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len)
+{
+    int ret;
+
+    if (d->bStreamEnd || d->bCorrupt)
+        return;
+
+    d->zs.next_in = (Bytef *)buf;
+    d->zs.avail_in = (uInt)len;
+
+    do {
+        d->zs.next_out = d->window;
+        d->zs.avail_out = sizeof(d->window);
+
+        ret = inflate(&d->zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            d->bCorrupt = TRUE;
+            return;
+        }
+
+        parserFeed(d, d->window, sizeof(d->window) - d->zs.avail_out);
+        if (ret == Z_STREAM_END) {
+            d->bStreamEnd = TRUE;
+            return;
+        }
+    } while (d->zs.avail_out == 0 || d->zs.avail_in > 0);
+}
+
+/*
+ * Response body with any chunk framing removed, compressed or not
+ */
+static void bodyFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len)
+{
+    unsigned char magic[2];
+    size_t magicLen;
+
+    // The first two bytes tell gzip (1f 8b) or zlib (78 xx) from plain text
+    if (d->body == FSC_XCONF_BODY_UNKNOWN) {
+        while (d->magicLen < 2 && len > 0) {
+            d->magic[d->magicLen++] = *buf++;
+            len--;
+        }
+        if (d->magicLen < 2)
+            return;
+
+        if ((d->magic[0] == 0x1f && d->magic[1] == 0x8b) ||
+            (d->magic[0] == 0x78 && ((d->magic[0] << 8) | d->magic[1]) % 31 == 0)) {
+            // 15 + 32 lets zlib detect gzip or zlib headers itself
+            memset(&d->zs, 0, sizeof(d->zs));
+            if (inflateInit2(&d->zs, 15 + 32) != Z_OK) {
+                d->bCorrupt = TRUE;
+                return;
+            }
+            d->bInflating = TRUE;
+            d->body = FSC_XCONF_BODY_DEFLATED;
+        } else {
+            d->body = FSC_XCONF_BODY_PLAIN;
+        }
+
+        memcpy(magic, d->magic, sizeof(magic));
+        magicLen = d->magicLen;
+        bodyFeed(d, magic, magicLen);
+    }
+
+    if (len == 0)
+        return;
+
+    if (d->body == FSC_XCONF_BODY_DEFLATED)
+        inflateFeed(d, buf, len);
+    else
+        parserFeed(d, buf, len);
+}
+
+static int hexValue(unsigned char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Strip chunk framing: <hex size>[;ext]\r\n<data>\r\n ... 0\r\n[trailers]\r\n
+ */
+static void chunkFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len)
+{
+    size_t i = 0, n;
+    int v;
+
+    while (i < len && !d->bCorrupt) {
+        switch (d->chunkState) {
+        case FSC_XCONF_CHUNK_SIZE:
+            if ((v = hexValue(buf[i])) >= 0) {
+                if (d->chunkLeft > FSC_XCONF_MAX_RESPONSE) {
+                    d->bCorrupt = TRUE;
+                    break;
+                }
+                d->chunkLeft = d->chunkLeft * 16 + (size_t)v;
+            } else if (buf[i] == '\n') {
+                d->chunkState = (d->chunkLeft > 0) ? FSC_XCONF_CHUNK_DATA : FSC_XCONF_CHUNK_TRAILER;
+            } else if (buf[i] != '\r') {
+                d->chunkState = FSC_XCONF_CHUNK_EXT;
+            }
+            i++;
+            break;
+        case FSC_XCONF_CHUNK_EXT:
+            if (buf[i++] == '\n')
+                d->chunkState = (d->chunkLeft > 0) ? FSC_XCONF_CHUNK_DATA : FSC_XCONF_CHUNK_TRAILER;
+            break;
+        case FSC_XCONF_CHUNK_DATA:
+            n = (len - i < d->chunkLeft) ? len - i : d->chunkLeft;
+            bodyFeed(d, buf + i, n);
+            d->chunkLeft -= n;
+            i += n;
+            if (d->chunkLeft == 0)
+                d->chunkState = FSC_XCONF_CHUNK_DATA_END;
+            break;
+        case FSC_XCONF_CHUNK_DATA_END:
+            if (buf[i++] == '\n')
+                d->chunkState = FSC_XCONF_CHUNK_SIZE;
+            break;
+        case FSC_XCONF_CHUNK_TRAILER:
+            // Trailers are skipped up to the empty line which ends the response
+            if (buf[i] == '\n') {
+                if (d->lineLen == 0)
+                    d->chunkState = FSC_XCONF_CHUNK_DONE;
+                d->lineLen = 0;
+            } else if (buf[i] != '\r') {
+                d->lineLen++;
+            }
+            i++;
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+/*
+ * Raw bytes from the file. Chunk framing is recognized by a hex size line at the very start.
+ */
+static void decoderFeed(fscXconfDecoder_t *d, const unsigned char *buf, size_t len)
+{
+    size_t i;
+
+    if (!d->bFramingKnown) {
+        for (i = 0; i < len && hexValue(buf[i]) >= 0; i++)
+            ;
+        d->bChunked = (i > 0 && i < len && (buf[i] == '\r' || buf[i] == '\n' || buf[i] == ';'));
+        d->bFramingKnown = TRUE;
+    }
+
+    if (d->bChunked)
+        chunkFeed(d, buf, len);
+    else
+        bodyFeed(d, buf, len);
+}
+
+/*
+ * Classify a response file, FSC_XCONF_NONE if there is none
+ */
+eFscXconfResult fscXconfClassifyFile(const char *path, char *firmware, size_t len)
+{
+    static fscXconfDecoder_t decoder;
+    unsigned char buf[FSC_XCONF_WINDOW];
+    eFscXconfResult result;
+    BOOLEAN bIncomplete;
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return FSC_XCONF_NONE;
+
+    memset(&decoder, 0, offsetof(fscXconfDecoder_t, window));
+    fscXconfParserInit(&decoder.parser);
+    while (!decoder.bCorrupt && (n = read(fd, buf, sizeof(buf))) > 0) {
+        decoderFeed(&decoder, buf, (size_t)n);
+        fscMetricsAdd(FSC_METRIC_BYTES_READ, n);
+    }
+    close(fd);
+
+    // Body too short to tell its encoding, it is plain text then
+    if (decoder.body == FSC_XCONF_BODY_UNKNOWN && decoder.magicLen > 0)
+        parserFeed(&decoder, decoder.magic, decoder.magicLen);
+
+    bIncomplete = (decoder.bChunked && decoder.chunkState != FSC_XCONF_CHUNK_DONE) ||
+                  (decoder.bInflating && !decoder.bStreamEnd);
+    if (decoder.bInflating)
+        inflateEnd(&decoder.zs);
+
+    result = fscXconfParserResult(&decoder.parser);
+    if (decoder.bCorrupt)
+        result = FSC_XCONF_ERROR;
+    else if (bIncomplete && result == FSC_XCONF_ERROR)
+        result = FSC_XCONF_PARTIAL;
+    snprintf(firmware, len, "%s", decoder.parser.firmware);
+
+    return result;
+}
+
+const char *fscXconfResultName(eFscXconfResult result)
+{
+    return (result <= FSC_XCONF_PARTIAL) ? resultNames[result] : "unknown";
+}
@@ -0,0 +1,134 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscXconfTest.c
+ * @brief XConf response classifier tests
+ *
+ * Each response is classified whole, split in two at every offset, and fed a byte at a time, and
+ * must come out the same every way.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fscMonitor.h"
+
+static const struct {
+    const char *name;
+    const char *response;
+    eFscXconfResult result;
+    const char *firmware;
+} cases[] = {
+    { "valid",
+      "{\"firmwareDownloadProtocol\":\"http\",\"firmwareFilename\":\"CGM4331COM_4.4p1s7_PROD_sey.bin\","
+      "\"firmwareVersion\":\"CGM4331COM_4.4p1s7_PROD_sey\",\"rebootImmediately\":false}",
+      FSC_XCONF_VALID, "CGM4331COM_4.4p1s7_PROD_sey.bin" },
+    { "valid with spaces",
+      "{ \"firmwareFilename\" : \"TEST_IMAGE_5.bin\" }\n",
+      FSC_XCONF_VALID, "TEST_IMAGE_5.bin" },
+    { "valid with an error field",
+      "{\"firmwareFilename\":\"TEST_IMAGE_5.bin\",\"error\":\"\"}",
+      FSC_XCONF_VALID, "TEST_IMAGE_5.bin" },
+    { "404 page",
+      "<html><head><title>404 Not Found</title></head><body>404 NOT FOUND</body></html>",
+      FSC_XCONF_UNKNOWN_DEVICE, "" },
+    { "404 json",
+      "{\"status\":404,\"message\":\"No rule found for estbMac\"}",
+      FSC_XCONF_UNKNOWN_DEVICE, "" },
+    { "html error page",
+      "<HTML><HEAD><TITLE>502 Proxy Error</TITLE></HEAD><BODY>The proxy could not reach the server</BODY></HTML>",
+      FSC_XCONF_ERROR, "" },
+    { "server error",
+      "{\"Error\":\"Internal Server Error\"}",
+      FSC_XCONF_ERROR, "" },
+    { "no firmware named",
+      "{\"firmwareDownloadProtocol\":\"http\",\"rebootImmediately\":false}",
+      FSC_XCONF_ERROR, "" },
+    { "key without a string",
+      "{\"firmwareFilename\":null}",
+      FSC_XCONF_ERROR, "" },
+    { "empty",
+      "",
+      FSC_XCONF_PARTIAL, "" },
+    { "partial json",
+      "{\"firmwareDownloadProtocol\":\"http\",\"firmw",
+      FSC_XCONF_PARTIAL, "" },
+    { "partial name",
+      "{\"firmwareDownloadProtocol\":\"http\",\"firmwareFilename\":\"CGM4331C",
+      FSC_XCONF_PARTIAL, "" },
+};
+
+#define NUM_CASES (int)(sizeof(cases) / sizeof(cases[0]))
+
+// The tests do not export metrics
+void fscMetricsAdd(eFscCounter counter, uint64_t value)
+{
+    (void)counter;
+    (void)value;
+}
+
+/*
+ * Classify the response fed in pieces of at most step bytes, the first piece being split bytes
+ */
+static BOOLEAN check(int i, size_t split, size_t step)
+{
+    fscXconfParser_t parser;
+    eFscXconfResult result;
+    const char *response = cases[i].response;
+    size_t len = strlen(response);
+    size_t offset, n;
+
+    fscXconfParserInit(&parser);
+    fscXconfParserFeed(&parser, response, split);
+    for (offset = split; offset < len; offset += n) {
+        n = (len - offset < step) ? len - offset : step;
+        fscXconfParserFeed(&parser, response + offset, n);
+    }
+
+    result = fscXconfParserResult(&parser);
+    if (result == cases[i].result && (result != FSC_XCONF_VALID || strcmp(parser.firmware, cases[i].firmware) == 0))
+        return TRUE;
+
+    printf("FAIL: %s split at %zu in pieces of %zu: %s \"%s\", expected %s \"%s\"\n", cases[i].name, split, step,
+           fscXconfResultName(result), parser.firmware, fscXconfResultName(cases[i].result), cases[i].firmware);
+    return FALSE;
+}
+
+int main(void)
+{
+    size_t len, split;
+    BOOLEAN bPassed;
+    int i, failed = 0;
+
+    for (i = 0; i < NUM_CASES; i++) {
+        len = strlen(cases[i].response);
+        bPassed = check(i, len, len) && check(i, 0, 1);
+
+        for (split = 1; bPassed && split < len; split++)
+            bPassed = check(i, split, len);
+
+        if (bPassed)
+            printf("PASS: %s\n", cases[i].name);
+        else
+            failed++;
+    }
+
+    printf("%d of %d cases passed\n", NUM_CASES - failed, NUM_CASES);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+/*
+ * @file fscctl.c
+ * @brief Firmware Sanity Checker control client
+ *
+ * fscctl status            query the running fscMonitor
+ * fscctl recheck           ask fscMonitor to take a sample right away
+ * fscctl debug on|off      toggle the debug override
+ * fscctl page              read the shared memory status page, works after fscMonitor exited
+ * fscctl bench [count]     measure status page read throughput and control query latency
+ * fscctl profile [file]    decode the resource profile stored at the last verdict
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <zlib.h>
+
+#include "fscCtl.h"
+#include "fscStatus.h"
+#include "fscProfile.h"
+#include "fscRoot.h"
+
+#define FSC_CTL_DEFAULT_BENCH_COUNT 100000
+
+static const char *phaseNames[] = { "starting", "checking", "done" };
+static const char *verdictNames[] = { "pending", "valid", "invalid" };
+static const char *xconfNames[] = { "none", "valid", "unknown-device", "error", "partial" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static void printStatus(const fscStatus_t *status)
+{
+    printf("pid:        %u\n", status->pid);
+    printf("phase:      %s\n", (status->phase <= FSC_PHASE_DONE) ? phaseNames[status->phase] : "unknown");
+    printf("verdict:    %s\n", (status->verdict <= FSC_VERDICT_INVALID) ? verdictNames[status->verdict] : "unknown");
+    printf("flags:      0x%x\n", status->flags);
+    printf("elapsed:    %u\n", status->elapsed);
+    printf("remaining:  %u\n", status->remaining);
+    printf("halTimeout: %u\n", status->halTimeout);
+    printf("samples:    %u\n", status->samples);
+    printf("probes:     0x%x\n", status->probes);
+    printf("components: 0x%x\n", status->components);
+    printf("restarts:   %u\n", status->restarts);
+    printf("memStallMs: %u\n", status->memoryStallMs);
+    printf("cpuStallMs: %u\n", status->cpuStallMs);
+    printf("oopses:     %u\n", status->kernelOopses);
+    printf("oomKills:   %u\n", status->oomKills);
+    printf("xconf:      %s\n", (status->xconfResult <= FSC_XCONF_PARTIAL) ? xconfNames[status->xconfResult] : "unknown");
+    printf("reason:     %s\n", status->reason);
+}
+
+static int ctlConnect(void)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    struct sockaddr_un addr;
+    int fd;
+
+    if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fscRootPath(FSC_CTL_SOCKET, path, sizeof(path)));
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Unable to connect to %s, is fscMonitor running?\n", addr.sun_path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int ctlTransact(int fd, uint16_t command, uint32_t arg, fscCtlResponse_t *rsp)
+{
+    fscCtlRequest_t req;
+
+    req.magic = FSC_CTL_MAGIC;
+    req.command = command;
+    req.arg = arg;
+
+    if (send(fd, &req, sizeof(req), MSG_NOSIGNAL) != (ssize_t)sizeof(req) ||
+        recv(fd, rsp, sizeof(*rsp), 0) != (ssize_t)sizeof(*rsp) ||
+        rsp->magic != FSC_CTL_MAGIC) {
+        fprintf(stderr, "Error talking to fscMonitor\n");
+        return -1;
+    }
+
+    return rsp->result;
+}
+
+static int benchmark(long count)
+{
+    char path[FSC_ROOT_PATH_LEN];
+    fscStatusReader_t reader;
+    fscStatus_t status;
+    fscCtlResponse_t rsp;
+    double start, elapsed;
+    long i, failed = 0;
+    int fd;
+
+    if (fscStatusOpen(&reader) != 0) {
+        fprintf(stderr, "Unable to open %s\n", fscRootPath(FSC_STATUS_FILE, path, sizeof(path)));
+        return 1;
+    }
+
+    start = now();
+    for (i = 0; i < count; i++) {
+        if (fscStatusRead(&reader, &status) != 0)
+            failed++;
+    }
+    elapsed = now() - start;
+    fscStatusClose(&reader);
+
+    printf("status page: %ld reads in %.3f s, %.1f ns/read, %.0f reads/s, %ld failed\n",
+           count, elapsed, elapsed * 1e9 / count, count / elapsed, failed);
+
+    if ((fd = ctlConnect()) < 0)
+        return 1;
+
+    // Socket queries are several orders of magnitude slower, keep the run short
+    count = (count > 10000) ? 10000 : count;
+    start = now();
+    for (i = 0; i < count; i++) {
+        if (ctlTransact(fd, FSC_CTL_STATUS, 0, &rsp) != 0)
+            break;
+    }
+    elapsed = now() - start;
+    close(fd);
+
+    printf("control socket: %ld queries in %.3f s, %.2f us/query\n", i, elapsed, i ? elapsed * 1e6 / i : 0.0);
+    return (i == count) ? 0 : 1;
+}
+
+static int printProfile(const char *file)
+{
+    fscProfileHeader_t header;
+    fscProfileSample_t *samples = NULL;
+    Bytef *compressed = NULL;
+    uLongf rawSize;
+    uint32_t i, total;
+    int ret = 1;
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != FSC_PROFILE_MAGIC ||
+        header.version != FSC_PROFILE_VERSION) {
+        fprintf(stderr, "%s is not a resource profile\n", file);
+        goto out;
+    }
+
+    rawSize = header.count * sizeof(fscProfileSample_t);
+    compressed = malloc(header.compressedSize);
+    samples = malloc(rawSize);
+    if (compressed == NULL || samples == NULL ||
+        fread(compressed, 1, header.compressedSize, fp) != header.compressedSize ||
+        (uint32_t)crc32(0L, compressed, header.compressedSize) != header.crc ||
+        uncompress((Bytef *)samples, &rawSize, compressed, header.compressedSize) != Z_OK ||
+        rawSize != header.count * sizeof(fscProfileSample_t)) {
+        fprintf(stderr, "%s is corrupt\n", file);
+        goto out;
+    }
+
+    printf("# image 0x%08x verdict %s, %u samples every %u s, %u dropped\n", header.image,
+           (header.verdict <= FSC_VERDICT_INVALID) ? verdictNames[header.verdict] : "unknown",
+           header.count, header.interval, header.dropped);
+    printf("uptime,user%%,system%%,iowait%%,irq%%,memAvailableKb,memFreeKb,cachedKb,load1,load5,load15,running,threads\n");
+    for (i = 0; i < header.count; i++) {
+        const fscProfileSample_t *s = &samples[i];
+
+        total = s->cpuUser + s->cpuSystem + s->cpuIdle + s->cpuIowait + s->cpuIrq;
+        total = total ? total : 1;
+        printf("%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u,%u,%.2f,%.2f,%.2f,%u,%u\n", s->uptimeMs / 1000.0,
+               100.0 * s->cpuUser / total, 100.0 * s->cpuSystem / total, 100.0 * s->cpuIowait / total,
+               100.0 * s->cpuIrq / total, s->memAvailableKb, s->memFreeKb, s->cachedKb,
+               s->load1 / 100.0, s->load5 / 100.0, s->load15 / 100.0, s->running, s->threads);
+    }
+    ret = 0;
+
+out:
+    free(compressed);
+    free(samples);
+    fclose(fp);
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-C <root dir>] status|recheck|debug on|off|page|bench [count]|profile [file]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    fscStatusReader_t reader;
+    fscCtlResponse_t rsp;
+    fscStatus_t status;
+    const char *name = argv[0];
+    char path[FSC_ROOT_PATH_LEN];
+    uint16_t command;
+    uint32_t arg = 0;
+    long count;
+    int fd, ret, opt;
+
+    // The root directory of a test instance, FSC_ROOT in the environment works as well
+    while ((opt = getopt(argc, argv, "+C:")) != -1) {
+        if (opt != 'C' || fscRootSet(optarg) != 0) {
+            usage(name);
+            return 1;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc < 2) {
+        usage(name);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "bench") == 0) {
+        count = (argc > 2) ? atol(argv[2]) : FSC_CTL_DEFAULT_BENCH_COUNT;
+        if (count < 1) {
+            usage(name);
+            return 1;
+        }
+        return benchmark(count);
+    }
+
+    if (strcmp(argv[1], "profile") == 0)
+        return printProfile((argc > 2) ? argv[2] : fscRootPath(FSC_PROFILE_FILE, path, sizeof(path)));
+
+    if (strcmp(argv[1], "page") == 0) {
+        if (fscStatusOpen(&reader) != 0 || fscStatusRead(&reader, &status) != 0) {
+            fprintf(stderr, "Unable to read %s\n", fscRootPath(FSC_STATUS_FILE, path, sizeof(path)));
+            return 1;
+        }
+        fscStatusClose(&reader);
+        printStatus(&status);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "status") == 0) {
+        command = FSC_CTL_STATUS;
+    } else if (strcmp(argv[1], "recheck") == 0) {
+        command = FSC_CTL_RECHECK;
+    } else if (strcmp(argv[1], "debug") == 0 && argc > 2 &&
+               (strcmp(argv[2], "on") == 0 || strcmp(argv[2], "off") == 0)) {
+        command = FSC_CTL_DEBUG_OVERRIDE;
+        arg = (strcmp(argv[2], "on") == 0) ? 1 : 0;
+    } else {
+        usage(name);
+        return 1;
+    }
+
+    if ((fd = ctlConnect()) < 0)
+        return 1;
+
+    ret = ctlTransact(fd, command, arg, &rsp);
+    close(fd);
+
+    if (ret != 0) {
+        fprintf(stderr, "Request failed\n");
+        return 1;
+    }
+
+    printStatus(&rsp.status);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#!/bin/sh
+##########################################################################
+# If not stated otherwise in this file or this component's Licenses.txt
+# file the following copyright and licenses apply:
+#
+# Copyright 2015 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+#
+# Replays event traces against fscMonitor, each in a private root, side by side.
+#
+# Usage: runReplay.sh [trace|dir ...]   defaults to the traces in replay/ next to this script
+#
+# FSC_MONITOR names the binary, ./fscMonitor by default. A trace can give extra fscMonitor
+# options on a "# options:" line, and text its output must hold on "# log:" lines. "# boots: <n>"
+# replays it n times in the same root, as consecutive boots which must all come out as expected.
+# "# image: <name>" sets the imagename in version.txt, "none" leaves version.txt out. Fails if any
+# trace does not come out as it expects, the output of a failed trace is shown.
+#
+
+FSC_MONITOR=${FSC_MONITOR:-./fscMonitor}
+TEST_DIR=$(dirname "$0")
+
+if [ $# -eq 0 ]; then
+    set -- "$TEST_DIR/replay"
+fi
+
+WORK=$(mktemp -d /tmp/fscReplay.XXXXXX) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+runTrace()
+{
+    trace=$1
+    root=$2
+    options=$(sed -n 's/^# options://p' "$trace")
+    boots=$(sed -n 's/^# boots: *//p' "$trace")
+    image=$(sed -n 's/^# image: *//p' "$trace")
+
+    mkdir -p "$root/tmp" "$root/nvram" "$root/dev/shm" "$root/rdklogs/logs" "$root/proc/sys/kernel"
+    if [ "${image:=TEST_PROD_1}" != none ]; then
+        printf 'imagename:%s\n' "$image" > "$root/version.txt"
+    fi
+    # Production images are only checked with the debug override
+    touch "$root/nvram/forceFSC"
+
+    : > "$root/output"
+    boot=1
+    while :; do
+        echo "Boot $boot" >> "$root/output"
+        # shellcheck disable=SC2086
+        "$FSC_MONITOR" --root "$root" --replay "$trace" $options >> "$root/output" 2>&1
+        status=$?
+        if [ $status -ne 0 ] || [ $boot -ge "${boots:-1}" ]; then
+            break
+        fi
+        boot=$((boot + 1))
+    done
+
+    sed -n 's/^# log: //p' "$trace" > "$root/logs"
+    while read -r text; do
+        if ! grep -qF -- "$text" "$root/output"; then
+            echo "Missing from the output: $text" >> "$root/output"
+            status=1
+        fi
+    done < "$root/logs"
+
+    echo $status > "$root/status"
+}
+
+n=0
+for arg in "$@"; do
+    if [ -d "$arg" ]; then
+        traces=$(ls "$arg"/*.trace)
+    else
+        traces=$arg
+    fi
+    for trace in $traces; do
+        n=$((n + 1))
+        echo "$trace" > "$WORK/$n.trace"
+        runTrace "$trace" "$WORK/$n" &
+    done
+done
+wait
+
+failed=0
+i=1
+while [ $i -le $n ]; do
+    trace=$(cat "$WORK/$i.trace")
+    if [ "$(cat "$WORK/$i/status" 2>/dev/null)" = 0 ]; then
+        echo "PASS: $trace"
+    else
+        echo "FAIL: $trace"
+        cat "$WORK/$i/output"
+        failed=$((failed + 1))
+    fi
+    i=$((i + 1))
+done
+
+echo "$((n - failed)) of $n traces passed"
+[ $failed -eq 0 ]
@@ -0,0 +1,111 @@
+#!/bin/sh
+##########################################################################
+# If not stated otherwise in this file or this component's Licenses.txt
+# file the following copyright and licenses apply:
+#
+# Copyright 2015 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+#
+# Replays the traces in stress/ under the injection shim, each in a private root, side by side, and
+# checks whether the verdict reached the hal before its deadline. The injected delays skew the
+# clock instead of being slept, so stalls of minutes per sample push the verdict towards the end of
+# an hour long check, or past it, in a few seconds of real time.
+#
+# Usage: stressInject.sh [trace ...]   defaults to the traces in stress/ next to this script
+#
+# FSC_MONITOR names the binary, ./fscMonitor by default, and FSC_INJECT_LIB the shim,
+# ./.libs/libfscinject.so by default. A trace gives the FSC_INJECT rules on an "# inject:" line,
+# where @ROOT@ stands for the root of the run, extra fscMonitor options on an "# options:" line,
+# and on a "# deadline: met|missed" line whether the verdict is to be in time. The hal stalls come
+# from the hal events of the trace. Fails if any trace is not replayed as it expects or the
+# deadline does not come out as stated, the output of a failed trace is shown.
+#
+
+FSC_MONITOR=${FSC_MONITOR:-./fscMonitor}
+FSC_INJECT_LIB=${FSC_INJECT_LIB:-./.libs/libfscinject.so}
+TEST_DIR=$(dirname "$0")
+
+if [ $# -eq 0 ]; then
+    set -- "$TEST_DIR"/stress/*.trace
+fi
+
+case $FSC_INJECT_LIB in
+    /*) ;;
+    *) FSC_INJECT_LIB=$(pwd)/$FSC_INJECT_LIB ;;
+esac
+if [ ! -f "$FSC_INJECT_LIB" ]; then
+    echo "No shim at $FSC_INJECT_LIB"
+    exit 1
+fi
+
+WORK=$(mktemp -d /tmp/fscStress.XXXXXX) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+runTrace()
+{
+    trace=$1
+    root=$2
+    options=$(sed -n 's/^# options://p' "$trace")
+    rules=$(sed -n 's/^# inject: *//p' "$trace" | sed "s|@ROOT@|$root|g")
+    deadline=$(sed -n 's/^# deadline: *//p' "$trace")
+
+    mkdir -p "$root/tmp" "$root/nvram" "$root/dev/shm" "$root/rdklogs/logs"
+    printf 'imagename:TEST_PROD_1\n' > "$root/version.txt"
+    touch "$root/nvram/forceFSC"
+
+    # shellcheck disable=SC2086
+    FSC_INJECT=$rules FSC_INJECT_SEED=1 FSC_INJECT_SKEW=1 LD_PRELOAD=$FSC_INJECT_LIB \
+        "$FSC_MONITOR" --root "$root" --replay "$trace" $options > "$root/output" 2>&1
+    status=$?
+
+    if grep -q "FSC_DEADLINE_MISSED" "$root/output"; then
+        result=missed
+    elif grep -q "Verdict delivered at" "$root/output"; then
+        result=met
+    else
+        result=none
+    fi
+    if [ "$result" != "${deadline:-met}" ]; then
+        echo "Deadline $result, expected ${deadline:-met}" >> "$root/output"
+        status=1
+    fi
+
+    echo $status > "$root/status"
+}
+
+n=0
+for trace in "$@"; do
+    n=$((n + 1))
+    echo "$trace" > "$WORK/$n.trace"
+    runTrace "$trace" "$WORK/$n" &
+done
+wait
+
+failed=0
+i=1
+while [ $i -le $n ]; do
+    trace=$(cat "$WORK/$i.trace")
+    if [ "$(cat "$WORK/$i/status" 2>/dev/null)" = 0 ]; then
+        echo "PASS: $trace: $(sed -n 's/.*\(Verdict delivered at [0-9.]* seconds\).*/\1/p; s/.*\(FSC_DEADLINE_MISSED.*\)/\1/p' "$WORK/$i/output")"
+    else
+        echo "FAIL: $trace"
+        cat "$WORK/$i/output"
+        failed=$((failed + 1))
+    fi
+    i=$((i + 1))
+done
+
+echo "$((n - failed)) of $n traces passed"
+[ $failed -eq 0 ]